@@ -0,0 +1,463 @@
+//
+//  AudioThreadMonitor.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioThreadMonitor.h"
+#include <atomic>
+
+#ifndef LIGHTHOST_AUDIO_DIAGNOSTICS
+#define LIGHTHOST_AUDIO_DIAGNOSTICS 0
+#endif
+
+// Interposition relies on glibc exporting its allocator as __libc_*, and
+// replaces symbols for the whole process, so it is opt-in at build time
+#if LIGHTHOST_AUDIO_DIAGNOSTICS && JUCE_LINUX && defined(__GLIBC__)
+#define LIGHTHOST_INTERPOSE 1
+#include <cerrno>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#else
+#define LIGHTHOST_INTERPOSE 0
+#endif
+
+static const int eventQueueSize = 2048;
+static const int maxFrames = 12;
+static const int maxNodeName = 48;
+static const int maxSites = 4096;
+static const int maxExpectedLocks = 256;
+// record() and the interposed function
+static const int framesToSkip = 2;
+
+struct Event
+{
+	int type;
+	size_t bytes;
+	char node[maxNodeName];
+	void* frames[maxFrames];
+	int numFrames;
+};
+
+// Plain statics: the hooks can run before any constructor in this file
+static std::atomic<int> monitorEnabled(0), numDroppedEvents(0);
+static AbstractFifo eventFifo(eventQueueSize);
+static Event events[eventQueueSize];
+static std::atomic<const void*> expectedLocks[maxExpectedLocks];
+
+#if LIGHTHOST_INTERPOSE
+static __thread bool isAudioThread = false;
+static __thread bool isRecording = false;
+static __thread const char* currentNode = nullptr;
+static __thread bool isInsidePlayer = false;
+
+static bool isExpectedLock(const void* lock) noexcept
+{
+	for (int i = 0; i < maxExpectedLocks; i++)
+		if (expectedLocks[i].load(std::memory_order_relaxed) == lock)
+			return true;
+	return false;
+}
+#endif
+
+struct AudioThreadMonitor::Site
+{
+	String node;
+	int type;
+	int64 count, bytes;
+	void* frames[maxFrames];
+	int numFrames;
+	uint64 hash;
+};
+
+static uint64 hashBytes(uint64 hash, const void* data, size_t size) noexcept
+{
+	// FNV-1a
+	const uint8* bytes = (const uint8*) data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static uint64 hashEvent(const Event& event) noexcept
+{
+	uint64 hash = 14695981039346656037ULL;
+	hash = hashBytes(hash, event.node, strlen(event.node));
+	hash = hashBytes(hash, &event.type, sizeof(event.type));
+	return hashBytes(hash, event.frames, sizeof(void*) * (size_t) event.numFrames);
+}
+
+//==============================================================================
+AudioThreadMonitor::AudioThreadMonitor() : numRecorded(0), numDropped(0)
+{
+}
+
+AudioThreadMonitor::~AudioThreadMonitor()
+{
+	setEnabled(false);
+}
+
+bool AudioThreadMonitor::isSupported() noexcept
+{
+	return LIGHTHOST_INTERPOSE != 0;
+}
+
+void AudioThreadMonitor::setEnabled(bool shouldEnable)
+{
+	if (!isSupported())
+		return;
+	#if LIGHTHOST_INTERPOSE
+	if (shouldEnable)
+	{
+		// The first backtrace loads the unwinder, which allocates; get that
+		// out of the way here rather than on the audio thread.
+		void* frame;
+		backtrace(&frame, 1);
+	}
+	#endif
+	monitorEnabled.store(shouldEnable ? 1 : 0);
+	if (shouldEnable)
+		startTimer(100);
+	else
+	{
+		stopTimer();
+		collect();
+	}
+}
+
+bool AudioThreadMonitor::isEnabled() const noexcept
+{
+	return monitorEnabled.load() != 0;
+}
+
+void AudioThreadMonitor::clear()
+{
+	collect();
+	sites.clear();
+	numRecorded = numDropped = 0;
+}
+
+void AudioThreadMonitor::timerCallback()
+{
+	collect();
+}
+
+void AudioThreadMonitor::collect()
+{
+	numDropped += numDroppedEvents.exchange(0);
+	const int numReady = eventFifo.getNumReady();
+	if (numReady == 0)
+		return;
+
+	int start1, size1, start2, size2;
+	eventFifo.prepareToRead(numReady, start1, size1, start2, size2);
+	for (int i = 0; i < size1 + size2; i++)
+	{
+		const Event& event = events[i < size1 ? start1 + i : start2 + i - size1];
+		const uint64 hash = hashEvent(event);
+		numRecorded++;
+
+		Site* site = nullptr;
+		for (int s = 0; s < sites.size() && site == nullptr; s++)
+			if (sites[s]->hash == hash)
+				site = sites[s];
+		if (site == nullptr)
+		{
+			if (sites.size() >= maxSites)
+			{
+				numDropped++;
+				continue;
+			}
+			site = sites.add(new Site());
+			site->node = String::fromUTF8(event.node);
+			site->type = event.type;
+			site->count = site->bytes = 0;
+			memcpy(site->frames, event.frames, sizeof(void*) * (size_t) event.numFrames);
+			site->numFrames = event.numFrames;
+			site->hash = hash;
+		}
+		site->count++;
+		site->bytes += (int64) event.bytes;
+	}
+	eventFifo.finishedRead(size1 + size2);
+}
+
+String AudioThreadMonitor::createReport()
+{
+	static const char* const typeNames[numEventTypes] = { "malloc", "realloc", "free", "mutex lock", "mutex trylock", "rwlock" };
+	collect();
+
+	String report;
+	report << "Light Host audio thread report, " << Time::getCurrentTime().toString(true, true) << newLine;
+	report << String(numRecorded) << " calls recorded, " << String(numDropped) << " dropped" << newLine;
+	// The host does not export its symbols, so its own frames show as offsets
+	report << "Resolve host frames such as \"Light Host(+0x1234)\" with: addr2line -f -C -e <path to Light Host> 0x1234" << newLine;
+	report << "Calls outside any plugin are listed under Host; the host's expected callback locks are left out." << newLine;
+
+	StringArray nodes;
+	for (int i = 0; i < sites.size(); i++)
+		nodes.addIfNotAlreadyThere(sites[i]->node);
+
+	for (int n = 0; n < nodes.size(); n++)
+	{
+		Array<Site*> nodeSites;
+		int64 totals[numEventTypes] = { 0 };
+		int64 allocatedBytes = 0;
+		for (int i = 0; i < sites.size(); i++)
+		{
+			if (sites[i]->node != nodes[n])
+				continue;
+			nodeSites.add(sites[i]);
+			totals[sites[i]->type] += sites[i]->count;
+			if (sites[i]->type == allocation || sites[i]->type == reallocation)
+				allocatedBytes += sites[i]->bytes;
+		}
+		// Busiest call sites first
+		for (int i = 1; i < nodeSites.size(); i++)
+			for (int j = i; j > 0 && nodeSites[j]->count > nodeSites[j - 1]->count; j--)
+				nodeSites.swap(j, j - 1);
+
+		StringArray summary;
+		for (int type = 0; type < numEventTypes; type++)
+			if (totals[type] > 0)
+				summary.add(String(typeNames[type]) + ": " + String(totals[type]));
+		report << newLine << "== " << nodes[n] << " ==" << newLine;
+		report << summary.joinIntoString(", ") << ", " << String(allocatedBytes) << " bytes allocated" << newLine;
+
+		for (int i = 0; i < nodeSites.size(); i++)
+		{
+			const Site& site = *nodeSites[i];
+			report << newLine << "  " << String(site.count) << " x " << typeNames[site.type];
+			if (site.bytes > 0)
+				report << ", " << String(site.bytes) << " bytes";
+			report << newLine;
+			#if LIGHTHOST_INTERPOSE
+			char** symbols = backtrace_symbols(site.frames, site.numFrames);
+			for (int f = 0; symbols != nullptr && f < site.numFrames; f++)
+				report << "      " << symbols[f] << newLine;
+			free(symbols);
+			#endif
+		}
+	}
+	return report;
+}
+
+//==============================================================================
+AudioThreadMonitor::ScopedAudioThread::ScopedAudioThread() noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	wasAudioThread = isAudioThread;
+	isAudioThread = true;
+	#else
+	wasAudioThread = false;
+	#endif
+}
+
+AudioThreadMonitor::ScopedAudioThread::~ScopedAudioThread() noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	isAudioThread = wasAudioThread;
+	#endif
+}
+
+AudioThreadMonitor::ScopedPlayer::ScopedPlayer() noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	isInsidePlayer = true;
+	#endif
+}
+
+AudioThreadMonitor::ScopedPlayer::~ScopedPlayer() noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	isInsidePlayer = false;
+	#endif
+}
+
+void AudioThreadMonitor::clearExpectedLocks() noexcept
+{
+	for (int i = 0; i < maxExpectedLocks; i++)
+		expectedLocks[i].store(nullptr);
+}
+
+void AudioThreadMonitor::addExpectedLock(const CriticalSection& lock) noexcept
+{
+	// On POSIX the CriticalSection is nothing but its pthread mutex, so its
+	// address is the one the interposed calls see
+	for (int i = 0; i < maxExpectedLocks; i++)
+	{
+		const void* empty = nullptr;
+		if (expectedLocks[i].load() == &lock || expectedLocks[i].compare_exchange_strong(empty, &lock))
+			return;
+	}
+	// Full: the lock shows up in the report
+	jassertfalse;
+}
+
+AudioThreadMonitor::ScopedNode::ScopedNode(const char* name) noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	previous = currentNode;
+	currentNode = name;
+	#else
+	ignoreUnused(name);
+	previous = nullptr;
+	#endif
+}
+
+AudioThreadMonitor::ScopedNode::~ScopedNode() noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	currentNode = previous;
+	#endif
+}
+
+void AudioThreadMonitor::record(EventType type, size_t bytes, const void* lock) noexcept
+{
+	#if LIGHTHOST_INTERPOSE
+	// isRecording stops backtrace's own calls from recursing back in here
+	if (!isAudioThread || isRecording || monitorEnabled.load(std::memory_order_relaxed) == 0)
+		return;
+	if (lock != nullptr)
+	{
+		// The player takes the graph's lock right after its own ones
+		if (isExpectedLock(lock))
+		{
+			isInsidePlayer = false;
+			return;
+		}
+		if (isInsidePlayer)
+			return;
+	}
+	isRecording = true;
+	int start1, size1, start2, size2;
+	eventFifo.prepareToWrite(1, start1, size1, start2, size2);
+	if (size1 + size2 < 1)
+		++numDroppedEvents;
+	else
+	{
+		Event& event = events[size1 > 0 ? start1 : start2];
+		event.type = type;
+		event.bytes = bytes;
+		const char* name = currentNode != nullptr ? currentNode : "Host";
+		int length = 0;
+		for (; length < maxNodeName - 1 && name[length] != 0; length++)
+			event.node[length] = name[length];
+		event.node[length] = 0;
+		void* frames[maxFrames + framesToSkip];
+		const int numFrames = backtrace(frames, maxFrames + framesToSkip);
+		event.numFrames = jmax(0, numFrames - framesToSkip);
+		memcpy(event.frames, frames + framesToSkip, sizeof(void*) * (size_t) event.numFrames);
+		eventFifo.finishedWrite(1);
+	}
+	isRecording = false;
+	#else
+	ignoreUnused(type, bytes, lock);
+	#endif
+}
+
+//==============================================================================
+#if LIGHTHOST_INTERPOSE
+// These definitions replace the libc symbols for the whole process, including
+// every plugin it loads. With the monitor off they cost a thread-local check.
+typedef int (*MutexFunction)(pthread_mutex_t*);
+typedef int (*RwLockFunction)(pthread_rwlock_t*);
+static std::atomic<MutexFunction> realMutexLock(nullptr), realMutexTryLock(nullptr);
+static std::atomic<RwLockFunction> realReadLock(nullptr), realWriteLock(nullptr);
+
+// Any thread can get here first; racing lookups store the same pointer
+template <typename Function>
+static Function resolve(std::atomic<Function>& cache, const char* name) noexcept
+{
+	Function function = cache.load(std::memory_order_acquire);
+	if (function == nullptr)
+	{
+		function = (Function) dlsym(RTLD_NEXT, name);
+		cache.store(function, std::memory_order_release);
+	}
+	return function;
+}
+
+extern "C"
+{
+	void* __libc_malloc(size_t);
+	void* __libc_calloc(size_t, size_t);
+	void* __libc_realloc(void*, size_t);
+	void* __libc_memalign(size_t, size_t);
+	void __libc_free(void*);
+
+	void* malloc(size_t size) __THROW
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::allocation, size);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) __THROW
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::allocation, count * size);
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* block, size_t size) __THROW
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::reallocation, size);
+		return __libc_realloc(block, size);
+	}
+
+	void* memalign(size_t alignment, size_t size) __THROW
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::allocation, size);
+		return __libc_memalign(alignment, size);
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) __THROW
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::allocation, size);
+		return __libc_memalign(alignment, size);
+	}
+
+	int posix_memalign(void** result, size_t alignment, size_t size) __THROW
+	{
+		if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+			return EINVAL;
+		AudioThreadMonitor::record(AudioThreadMonitor::allocation, size);
+		void* block = __libc_memalign(alignment, size);
+		if (block == nullptr)
+			return ENOMEM;
+		*result = block;
+		return 0;
+	}
+
+	void free(void* block) __THROW
+	{
+		if (block != nullptr)
+			AudioThreadMonitor::record(AudioThreadMonitor::deallocation, 0);
+		__libc_free(block);
+	}
+
+	int pthread_mutex_lock(pthread_mutex_t* mutex) __THROWNL
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::mutexLock, 0, mutex);
+		return resolve(realMutexLock, "pthread_mutex_lock")(mutex);
+	}
+
+	int pthread_mutex_trylock(pthread_mutex_t* mutex) __THROWNL
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::mutexTryLock, 0, mutex);
+		return resolve(realMutexTryLock, "pthread_mutex_trylock")(mutex);
+	}
+
+	int pthread_rwlock_rdlock(pthread_rwlock_t* lock) __THROWNL
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::readWriteLock, 0, lock);
+		return resolve(realReadLock, "pthread_rwlock_rdlock")(lock);
+	}
+
+	int pthread_rwlock_wrlock(pthread_rwlock_t* lock) __THROWNL
+	{
+		AudioThreadMonitor::record(AudioThreadMonitor::readWriteLock, 0, lock);
+		return resolve(realWriteLock, "pthread_rwlock_wrlock")(lock);
+	}
+}
+#endif
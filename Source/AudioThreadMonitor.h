@@ -0,0 +1,99 @@
+//
+//  AudioThreadMonitor.h
+//  Light Host
+//
+//  Diagnostic mode that catches memory allocation and lock calls made inside
+//  the device callback. Linux builds with LIGHTHOST_AUDIO_DIAGNOSTICS=1 (the
+//  Debug configuration) interpose malloc, free and the pthread mutex calls;
+//  while the monitor is enabled, each call made on the audio thread is pushed
+//  with its stack and the node being rendered into a lock-free FIFO. The
+//  message thread drains it into a per-plugin report. The callback locks the
+//  host takes on purpose every block are skipped by address; every other
+//  lock is reported, under Host when no plugin is rendering.
+//
+
+#ifndef AudioThreadMonitor_h
+#define AudioThreadMonitor_h
+
+class AudioThreadMonitor : private Timer
+{
+public:
+	enum EventType
+	{
+		allocation = 0,
+		reallocation,
+		deallocation,
+		mutexLock,
+		mutexTryLock,
+		readWriteLock,
+		numEventTypes
+	};
+
+	AudioThreadMonitor();
+	~AudioThreadMonitor();
+
+	// Whether this build can interpose the allocator and lock calls
+	static bool isSupported() noexcept;
+
+	// Message thread
+	void setEnabled(bool enabled);
+	bool isEnabled() const noexcept;
+	void clear();
+	String createReport();
+
+	// Audio thread. Marks the calling thread as the device callback while in scope.
+	class ScopedAudioThread
+	{
+	public:
+		ScopedAudioThread() noexcept;
+		~ScopedAudioThread() noexcept;
+	private:
+		bool wasAudioThread;
+		JUCE_DECLARE_NON_COPYABLE(ScopedAudioThread)
+	};
+
+	// Audio thread. AudioProcessorPlayer keeps its locks private, so while in
+	// scope every lock taken before the first expected one counts as the
+	// player's own and is not recorded.
+	class ScopedPlayer
+	{
+	public:
+		ScopedPlayer() noexcept;
+		~ScopedPlayer() noexcept;
+	private:
+		JUCE_DECLARE_NON_COPYABLE(ScopedPlayer)
+	};
+
+	// Message thread. Callback locks the graph, its nodes and the slots take
+	// every block by design. Cleared and registered again on each rebuild.
+	static void clearExpectedLocks() noexcept;
+	static void addExpectedLock(const CriticalSection& lock) noexcept;
+
+	// Audio thread. Attributes calls to the named node while in scope; the
+	// name must stay valid until the scope ends.
+	class ScopedNode
+	{
+	public:
+		ScopedNode(const char* name) noexcept;
+		~ScopedNode() noexcept;
+	private:
+		const char* previous;
+		JUCE_DECLARE_NON_COPYABLE(ScopedNode)
+	};
+
+	// Called from the interposed functions; lock is the mutex for lock calls
+	static void record(EventType type, size_t bytes, const void* lock = nullptr) noexcept;
+
+private:
+	struct Site;
+
+	void timerCallback() override;
+	void collect();
+
+	OwnedArray<Site> sites;
+	int64 numRecorded, numDropped;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioThreadMonitor)
+};
+
+#endif /* AudioThreadMonitor_h */
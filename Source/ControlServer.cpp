@@ -0,0 +1,262 @@
+//
+//  ControlServer.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ControlServer.h"
+#if ! JUCE_WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// A client that sends this much without a newline is dropped
+static const int maxLineLength = 4096;
+
+// Runs a command on the message thread. The server thread waits for it with a
+// timeout so shutting down never deadlocks against the message thread.
+class ControlServer::CommandMessage : public CallbackMessage
+{
+public:
+	CommandMessage(Handler& h, const StringArray& t) : handler(h), tokens(t), done(true) {}
+
+	void messageCallback() override
+	{
+		if (cancelled.get() == 0)
+			handler.handleControlCommand(tokens, reply);
+		done.signal();
+	}
+
+	Handler& handler;
+	const StringArray tokens;
+	StringArray reply;
+	WaitableEvent done;
+	Atomic<int> cancelled;
+};
+
+ControlServer::ControlServer(Handler& h) : Thread("Control Server"), handler(h), listenFd(-1)
+{
+}
+
+ControlServer::~ControlServer()
+{
+	stop();
+}
+
+bool ControlServer::start(const File& file)
+{
+	stop();
+	#if JUCE_WINDOWS
+	lastError = "The control socket is not available on Windows";
+	return false;
+	#else
+	socketFile = file;
+	sockaddr_un address;
+	zerostruct(address);
+	address.sun_family = AF_UNIX;
+	const String path = socketFile.getFullPathName();
+	if (path.getNumBytesAsUTF8() >= sizeof(address.sun_path))
+	{
+		lastError = "Socket path is too long: " + path;
+		return false;
+	}
+	path.copyToUTF8(address.sun_path, sizeof(address.sun_path));
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0)
+	{
+		lastError = "Could not create socket";
+		return false;
+	}
+	// A stale socket from a crashed run would make bind fail. Anything else
+	// at that path is left alone; it is most likely a mistyped setting.
+	struct stat existing;
+	if (lstat(address.sun_path, &existing) == 0)
+	{
+		if (!S_ISSOCK(existing.st_mode))
+		{
+			lastError = "Not a socket, refusing to replace it: " + path;
+			close(listenFd);
+			listenFd = -1;
+			return false;
+		}
+		unlink(address.sun_path);
+	}
+	// The umask makes bind create the socket as 0600 from the start, so there
+	// is no window in which other users can connect
+	const mode_t previousMask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+	const bool listening = bind(listenFd, (sockaddr*) &address, sizeof(address)) == 0 && listen(listenFd, 4) == 0;
+	umask(previousMask);
+	if (!listening)
+	{
+		lastError = "Could not listen on " + path;
+		close(listenFd);
+		listenFd = -1;
+		return false;
+	}
+
+	lastError = String();
+	startThread();
+	return true;
+	#endif
+}
+
+void ControlServer::stop()
+{
+	stopThread(2000);
+	#if ! JUCE_WINDOWS
+	for (int i = 0; i < clients.size(); i++)
+		close(clients.getReference(i).fd);
+	clients.clear();
+	if (listenFd >= 0)
+	{
+		close(listenFd);
+		listenFd = -1;
+		socketFile.deleteFile();
+	}
+	#endif
+}
+
+void ControlServer::run()
+{
+	#if ! JUCE_WINDOWS
+	const int maxClients = 8;
+	while (!threadShouldExit())
+	{
+		pollfd fds[maxClients + 1];
+		fds[0].fd = listenFd;
+		fds[0].events = POLLIN;
+		for (int i = 0; i < clients.size(); i++)
+		{
+			fds[i + 1].fd = clients.getReference(i).fd;
+			fds[i + 1].events = POLLIN;
+		}
+		const int numFds = clients.size() + 1;
+		if (poll(fds, (nfds_t) numFds, 100) <= 0)
+			continue;
+
+		for (int i = numFds - 1; i > 0; i--)
+		{
+			if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+				continue;
+			Client& client = clients.getReference(i - 1);
+			char buffer[1024];
+			const ssize_t numRead = read(client.fd, buffer, sizeof(buffer));
+			if (numRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+				continue;
+			if (numRead <= 0)
+			{
+				close(client.fd);
+				clients.remove(i - 1);
+				continue;
+			}
+			client.pending += String::fromUTF8(buffer, (int) numRead);
+			bool keep = true;
+			int newline;
+			while (keep && (newline = client.pending.indexOfChar('\n')) >= 0)
+			{
+				const String line = client.pending.substring(0, newline).trim();
+				client.pending = client.pending.substring(newline + 1);
+				if (line.isNotEmpty())
+					keep = handleLine(client.fd, line);
+				if (threadShouldExit())
+					return;
+			}
+			if (!keep || client.pending.getNumBytesAsUTF8() > maxLineLength)
+			{
+				close(client.fd);
+				clients.remove(i - 1);
+			}
+		}
+
+		if ((fds[0].revents & POLLIN) != 0)
+		{
+			const int fd = accept(listenFd, nullptr, nullptr);
+			if (fd >= 0 && clients.size() < maxClients)
+			{
+				// Replies never block the server: a client that stops reading
+				// is dropped once its socket buffer is full
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				#if JUCE_MAC
+				int noSigPipe = 1;
+				setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+				#endif
+				Client client;
+				client.fd = fd;
+				clients.add(client);
+			}
+			else if (fd >= 0)
+				close(fd);
+		}
+	}
+	#endif
+}
+
+bool ControlServer::handleLine(int fd, const String& line)
+{
+	StringArray tokens;
+	tokens.addTokens(line, " \t", "\"");
+	tokens.removeEmptyStrings();
+	for (int i = 0; i < tokens.size(); i++)
+		tokens.set(i, tokens[i].unquoted());
+
+	StringArray reply;
+	// Parameter changes bypass the message thread entirely
+	if (tokens[0] == "set")
+	{
+		if (tokens.size() != 4)
+			reply.add("error usage: set <index> <param> <value>");
+		else if (handler.queueParameterChange(tokens[1].getIntValue(), tokens[2].getIntValue(), tokens[3].getFloatValue()))
+			reply.add("ok");
+		else
+			reply.add("error no such plugin or queue full");
+		return sendReply(fd, reply);
+	}
+
+	ReferenceCountedObjectPtr<CommandMessage> message(new CommandMessage(handler, tokens));
+	message->post();
+	while (!message->done.wait(50))
+	{
+		if (threadShouldExit())
+		{
+			message->cancelled.set(1);
+			return false;
+		}
+	}
+	return sendReply(fd, message->reply);
+}
+
+bool ControlServer::sendReply(int fd, const StringArray& reply)
+{
+	#if ! JUCE_WINDOWS
+	#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+	#else
+	const int flags = 0;
+	#endif
+	const String text = reply.joinIntoString("\n") + "\n";
+	const char* data = text.toRawUTF8();
+	size_t remaining = text.getNumBytesAsUTF8();
+	while (remaining > 0)
+	{
+		const ssize_t sent = send(fd, data, remaining, flags);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		// Includes a full socket buffer; the rest of the reply would be lost
+		// anyway, so the client is dropped rather than left out of step
+		if (sent <= 0)
+			return false;
+		data += sent;
+		remaining -= (size_t) sent;
+	}
+	return true;
+	#else
+	ignoreUnused(fd, reply);
+	return false;
+	#endif
+}
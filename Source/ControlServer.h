@@ -0,0 +1,73 @@
+//
+//  ControlServer.h
+//  Light Host
+//
+//  Local control endpoint: a Unix domain socket accepting one text command
+//  per line. Chain edits are forwarded to the message thread; parameter
+//  changes go straight to the plugin's lock-free queue so they never wait
+//  on the UI.
+//
+//  list                         plugin <index> <bypassed> <name>
+//  bypass <index> <0|1>
+//  move <index> <newIndex>
+//  add <name>                   known plugin or built-in processor
+//  delete <index>
+//  snapshot                     save all plugin states
+//  params <index>               param <param> <value> <name>
+//  get <index> <param>          value <value>
+//  set <index> <param> <value>  applied at the next block boundary
+//  capture <index> <a|b>        store the current parameters as a morph point
+//  morph <index> <a|b> [secs]   glide to a morph point, default morphTime
+//  meters                       meter <peak dB> <rms dB> <LUFS> <name>
+//  status                       status <plugins> <MIDI events dropped>
+//
+//  Every command is answered with "ok" or "error <reason>" as its last line.
+//
+
+#ifndef ControlServer_h
+#define ControlServer_h
+
+class ControlServer : private Thread
+{
+public:
+	class Handler
+	{
+	public:
+		virtual ~Handler() {}
+		// Called on the message thread; appends reply lines, the last one being "ok" or "error ..."
+		virtual void handleControlCommand(const StringArray& tokens, StringArray& reply) = 0;
+		// Called on the server thread; must not wait for the message thread
+		virtual bool queueParameterChange(int pluginIndex, int parameterIndex, float value) = 0;
+	};
+
+	ControlServer(Handler& handler);
+	~ControlServer();
+
+	bool start(const File& socketFile);
+	void stop();
+	bool isRunning() const					{ return isThreadRunning(); }
+	const String& getLastError() const		{ return lastError; }
+
+private:
+	class CommandMessage;
+	struct Client
+	{
+		int fd;
+		String pending;
+	};
+
+	void run() override;
+	// Both return false once the client has to be dropped
+	bool handleLine(int fd, const String& line);
+	bool sendReply(int fd, const StringArray& reply);
+
+	Handler& handler;
+	File socketFile;
+	int listenFd;
+	Array<Client> clients;
+	String lastError;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ControlServer)
+};
+
+#endif /* ControlServer_h */
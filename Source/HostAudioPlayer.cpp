@@ -0,0 +1,61 @@
+//
+//  HostAudioPlayer.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "HostAudioPlayer.h"
+#include "VectorOps.h"
+#include "AudioThreadMonitor.h"
+
+HostAudioPlayer::HostAudioPlayer()
+{
+}
+
+HostAudioPlayer::~HostAudioPlayer()
+{
+}
+
+void HostAudioPlayer::audioDeviceIOCallback(const float** inputChannelData, int numInputChannels,
+	float** outputChannelData, int numOutputChannels, int numSamples)
+{
+	const AudioThreadMonitor::ScopedAudioThread audioThread;
+	// Backends may recreate the audio thread, so the FPU mode is set every block
+	VectorOps::disableDenormals();
+	realtime.applyToCurrentThread();
+	inputMeter.process(inputChannelData, numInputChannels, numSamples);
+	{
+		const AudioThreadMonitor::ScopedPlayer playerLocks;
+		AudioProcessorPlayer::audioDeviceIOCallback(inputChannelData, numInputChannels,
+			outputChannelData, numOutputChannels, numSamples);
+	}
+	outputMeter.process(outputChannelData, numOutputChannels, numSamples);
+}
+
+void HostAudioPlayer::audioDeviceAboutToStart(AudioIODevice* device)
+{
+	realtime.threadChanged();
+	AudioProcessorPlayer::audioDeviceAboutToStart(device);
+	inputMeter.prepare(device->getCurrentSampleRate());
+	outputMeter.prepare(device->getCurrentSampleRate());
+	if (realtime.isEnabled())
+		prefaultBuffers(device);
+}
+
+void HostAudioPlayer::prefaultBuffers(AudioIODevice* device)
+{
+	// One silent block through the freshly prepared graph touches every render
+	// buffer, so the first real callbacks do not page fault.
+	AudioProcessor* processor = getCurrentProcessor();
+	if (processor == nullptr)
+		return;
+	const int numChannels = jmax(2, processor->getTotalNumInputChannels(), processor->getTotalNumOutputChannels());
+	AudioBuffer<float> silence(numChannels, device->getCurrentBufferSizeSamples());
+	silence.clear();
+	MidiBuffer midi;
+	{
+		const ScopedLock sl(processor->getCallbackLock());
+		processor->processBlock(silence, midi);
+	}
+	realtime.setResult(RealtimeSupport::prefaultStep, RealtimeSupport::succeeded);
+}
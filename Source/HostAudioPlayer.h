@@ -0,0 +1,40 @@
+//
+//  HostAudioPlayer.h
+//  Light Host
+//
+//  Device callback that drives the plugin graph. Sets up the audio thread
+//  before handing each block to AudioProcessorPlayer.
+//
+
+#ifndef HostAudioPlayer_h
+#define HostAudioPlayer_h
+
+#include "LevelMeter.h"
+#include "RealtimeSupport.h"
+
+class HostAudioPlayer : public AudioProcessorPlayer
+{
+public:
+	HostAudioPlayer();
+	~HostAudioPlayer();
+
+	void audioDeviceIOCallback(const float** inputChannelData, int numInputChannels,
+		float** outputChannelData, int numOutputChannels, int numSamples) override;
+	void audioDeviceAboutToStart(AudioIODevice* device) override;
+
+	// Levels at the device input, before the chain, and at the device output
+	const LevelMeter& getInputMeter() const noexcept	{ return inputMeter; }
+	const LevelMeter& getOutputMeter() const noexcept	{ return outputMeter; }
+
+	RealtimeSupport& getRealtimeSupport() noexcept		{ return realtime; }
+
+private:
+	void prefaultBuffers(AudioIODevice* device);
+
+	LevelMeter inputMeter, outputMeter;
+	RealtimeSupport realtime;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HostAudioPlayer)
+};
+
+#endif /* HostAudioPlayer_h */
@@ -1,5 +1,6 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "IconMenu.hpp"
+#include "Trace.h"
 
 #if ! (JUCE_PLUGINHOST_VST || JUCE_PLUGINHOST_VST3 || JUCE_PLUGINHOST_AU)
  #error "If you're building the audio plugin host, you probably want to enable VST and/or AU support"
@@ -13,6 +14,11 @@ public:
 
     void initialise (const String&) override
     {
+        // Enabled first so the rest of startup is recorded
+        StringArray trace = getParameter("-trace");
+        if (trace.size() == 2)
+            Trace::setEnabled(true);
+        TRACE_SCOPE("PluginHostApp::initialise");
         PropertiesFile::Options options;
         options.applicationName     = getApplicationName();
         options.filenameSuffix      = "settings";
@@ -22,10 +28,15 @@ public:
 
         appProperties = new ApplicationProperties();
         appProperties->setStorageParameters (options);
+        // -trace writes the recording on exit; -trace=<file> chooses where
+        if (trace.size() == 2)
+            traceFile = trace[1] != trace[0] ? File::getCurrentWorkingDirectory().getChildFile(trace[1])
+                : appProperties->getUserSettings()->getFile().withFileExtension("trace.json");
 
         LookAndFeel::setDefaultLookAndFeel (&lookAndFeel);
 
         mainWindow = new IconMenu();
+        applyMorphArguments(getCommandLineParameterArray());
 		#if JUCE_MAC
 			Process::setDockIconVisible(false);
 		#endif
@@ -34,6 +45,8 @@ public:
     void shutdown() override
     {
         mainWindow = nullptr;
+        if (traceFile != File())
+            Trace::exportJson(traceFile);
         appProperties = nullptr;
         LookAndFeel::setDefaultLookAndFeel (nullptr);
     }
@@ -43,6 +56,12 @@ public:
         JUCEApplicationBase::quit();
     }
 
+    void anotherInstanceStarted (const String& commandLine) override
+    {
+        // Lets a second launch drive the running instance
+        applyMorphArguments(StringArray::fromTokens(commandLine, true));
+    }
+
     const String getApplicationName() override       { return "Light Host"; }
     const String getApplicationVersion() override    { return ProjectInfo::versionString; }
     bool moreThanOneInstanceAllowed() override       {
@@ -53,6 +72,7 @@ public:
     ApplicationCommandManager commandManager;
     ScopedPointer<ApplicationProperties> appProperties;
     LookAndFeel_V3 lookAndFeel;
+    File traceFile;
 
 private:
     ScopedPointer<IconMenu> mainWindow;
@@ -80,6 +100,20 @@ private:
         if (multiInstance.size() == 2)
             options->filenameSuffix = multiInstance[1] + "." + options->filenameSuffix;
     }
+
+    // -morph=<plugin index>,<a|b>[,<seconds>]
+    void applyMorphArguments(const StringArray& parameters) {
+        for (int i = 0; i < parameters.size(); ++i)
+        {
+            String param = parameters[i].unquoted();
+            if (!param.startsWith("-morph=") || mainWindow == nullptr)
+                continue;
+            StringArray values = StringArray::fromTokens(param.fromFirstOccurrenceOf("=", false, false), ",", String());
+            if (values.size() >= 2)
+                mainWindow->morphPlugin(values[0].getIntValue(), values[1].equalsIgnoreCase("b") ? 1 : 0,
+                    values.size() > 2 ? values[2].getDoubleValue() : -1.0);
+        }
+    }
 };
 
 static PluginHostApp& getApp()                      { return *dynamic_cast<PluginHostApp*>(JUCEApplication::getInstance()); }
@@ -9,6 +9,8 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "IconMenu.hpp"
 #include "PluginWindow.h"
+#include "PluginSlot.h"
+#include "Trace.h"
 #include <ctime>
 #include <limits.h>
 #if JUCE_WINDOWS
@@ -60,37 +62,170 @@ private:
 	IconMenu& owner;
 };
 
-IconMenu::IconMenu() : INDEX_EDIT(1000000), INDEX_BYPASS(2000000), INDEX_DELETE(3000000), INDEX_MOVE_UP(4000000), INDEX_MOVE_DOWN(5000000)
+class IconMenu::MeterWindow : public DocumentWindow
+{
+public:
+	MeterWindow(IconMenu& owner_)
+		: DocumentWindow("Meters", Colours::white,
+			DocumentWindow::minimiseButton | DocumentWindow::closeButton),
+		owner(owner_)
+	{
+		setContentOwned(new MeterComponent(owner), true);
+		setUsingNativeTitleBar(true);
+		setResizable(true, false);
+		setResizeLimits(250, 60, 1200, 1500);
+		setTopLeftPosition(60, 60);
+
+		restoreWindowStateFromString(getAppProperties().getUserSettings()->getValue("meterWindowPos"));
+		setVisible(true);
+	}
+
+	~MeterWindow()
+	{
+		getAppProperties().getUserSettings()->setValue("meterWindowPos", getWindowStateAsString());
+
+		clearContentComponent();
+	}
+
+	void closeButtonPressed()
+	{
+		#if JUCE_MAC
+		if (!PluginWindow::containsActiveWindows())
+			Process::setDockIconVisible(false);
+		#endif
+		owner.meterWindow = nullptr;
+	}
+
+private:
+	// One row per tap: peak bar, RMS bar and momentary loudness
+	class MeterComponent : public Component, private Timer
+	{
+	public:
+		MeterComponent(IconMenu& owner_) : owner(owner_)
+		{
+			setSize(400, 3 * rowHeight);
+			startTimerHz(30);
+		}
+
+		void paint(Graphics& g) override
+		{
+			Array<const LevelMeter*> meters;
+			StringArray names;
+			owner.getMeterTaps(meters, names);
+
+			g.fillAll(Colour::fromRGB(236, 236, 236));
+			g.setFont(12.0f);
+			const int labelWidth = 120, loudnessWidth = 70;
+			for (int i = 0; i < meters.size(); i++)
+			{
+				juce::Rectangle<int> row(0, i * rowHeight, getWidth(), rowHeight);
+				row.reduce(4, 3);
+				g.setColour(Colours::black);
+				g.drawText(names[i], row.removeFromLeft(labelWidth), Justification::centredLeft, true);
+				float lufs = meters[i]->getLoudness();
+				g.drawText(lufs > -99.0f ? String(lufs, 1) + " LUFS" : "-inf LUFS",
+					row.removeFromRight(loudnessWidth), Justification::centredRight, false);
+
+				row.removeFromRight(4);
+				g.setColour(Colours::darkgrey);
+				g.fillRect(row);
+				float peak = meters[i]->getPeak();
+				g.setColour(peak >= 1.0f ? Colours::red : Colours::limegreen);
+				g.fillRect(row.withWidth(roundToInt(row.getWidth() * toProportion(peak))));
+				g.setColour(Colours::darkgreen);
+				g.fillRect(row.withWidth(roundToInt(row.getWidth() * toProportion(meters[i]->getRms()))));
+			}
+		}
+
+	private:
+		static const int rowHeight = 22;
+
+		// -60 dBFS to 0 dBFS across the bar
+		static float toProportion(float gain)
+		{
+			return jlimit(0.0f, 1.0f, (Decibels::gainToDecibels(gain, -60.0f) + 60.0f) / 60.0f);
+		}
+
+		void timerCallback() override
+		{
+			Array<const LevelMeter*> meters;
+			StringArray names;
+			owner.getMeterTaps(meters, names);
+			if (getHeight() != meters.size() * rowHeight)
+				setSize(getWidth(), meters.size() * rowHeight);
+			repaint();
+		}
+
+		IconMenu& owner;
+	};
+
+	IconMenu& owner;
+};
+
+IconMenu::IconMenu() : INDEX_EDIT(1000000), INDEX_BYPASS(2000000), INDEX_DELETE(3000000), INDEX_MOVE_UP(4000000), INDEX_MOVE_DOWN(5000000), INDEX_SANITIZE(6000000), INDEX_CLEAR_FAULT(7000000), INDEX_BUILT_IN(8000000), INDEX_MIDI(9000000), INDEX_OVERSAMPLE(10000000), INDEX_MORPH(11000000), controlServer(*this), watchdog(slotLock, slots), stateJournal(*this)
 {
     // Initiialization
     formatManager.addDefaultFormats();
+	formatManager.addFormat(internalFormat = new InternalPluginFormat());
+	internalFormat->getAllTypes(internalTypes);
 	#if JUCE_WINDOWS
 	x = y = 0;
 	#endif
     // Audio device
     ScopedPointer<XmlElement> savedAudioState (getAppProperties().getUserSettings()->getXmlValue("audioDeviceState"));
-    deviceManager.initialise(256, 256, savedAudioState, true);
+	{
+		TRACE_SCOPE("deviceManager.initialise");
+		deviceManager.initialise(256, 256, savedAudioState, true);
+	}
     player.setProcessor(&graph);
     deviceManager.addAudioCallback(&player);
+	deviceManager.addMidiInputCallback(String(), &midiInputQueue);
     // Plugins - all
     ScopedPointer<XmlElement> savedPluginList(getAppProperties().getUserSettings()->getXmlValue("pluginList"));
     if (savedPluginList != nullptr)
+    {
+        TRACE_SCOPE("knownPluginList.recreateFromXml");
         knownPluginList.recreateFromXml(*savedPluginList);
+    }
     pluginSortMethod = KnownPluginList::sortByManufacturer;
     knownPluginList.addChangeListener(this);
     // Plugins - active
     ScopedPointer<XmlElement> savedPluginListActive(getAppProperties().getUserSettings()->getXmlValue("pluginListActive"));
     if (savedPluginListActive != nullptr)
+    {
+        TRACE_SCOPE("activePluginList.recreateFromXml");
         activePluginList.recreateFromXml(*savedPluginListActive);
+    }
+	// Plugin states autosaved since the settings file was last written
+	stateJournal.open(getAppProperties().getUserSettings()->getFile().withFileExtension("journal"),
+		getAppProperties().getUserSettings()->getDoubleValue("autosaveInterval", 10.0));
+	if (stateJournal.getNumRecovered() > 0)
+		AlertWindow::showMessageBoxAsync(AlertWindow::InfoIcon, "Plugin States Recovered",
+			"Light Host did not shut down cleanly. " + String(stateJournal.getNumRecovered())
+			+ " plugin state(s) were restored from the autosave journal.");
     loadActivePlugins();
     activePluginList.addChangeListener(this);
+	// Control socket
+	if (getAppProperties().getUserSettings()->getBoolValue("controlSocket", false))
+		startControlServer();
+	// Real-time scheduling and memory locking
+	if (getAppProperties().getUserSettings()->getBoolValue("lowLatencyMode", false))
+		applyLowLatencyMode();
+	// Bypasses plugins that overrun the block budget or stall
+	applyWatchdog();
+	// Records allocations and locks on the audio thread
+	audioMonitor.setEnabled(getAppProperties().getUserSettings()->getBoolValue("audioDiagnostics", false));
 	setIcon();
 	setIconTooltip(JUCEApplication::getInstance()->getApplicationName());
 };
 
 IconMenu::~IconMenu()
 {
+	controlServer.stop();
+	watchdog.stop();
+	deviceManager.removeMidiInputCallback(String(), &midiInputQueue);
 	savePluginStates();
+	stateJournal.close();
 }
 
 void IconMenu::setIcon()
@@ -122,19 +257,40 @@ void IconMenu::setIcon()
 
 void IconMenu::loadActivePlugins()
 {
+	TRACE_SCOPE("loadActivePlugins");
 	const int INPUT = 1000000;
 	const int OUTPUT = INPUT + 1;
+	const int MIDI_INPUT = INPUT + 2;
 	const int CHANNEL_ONE = 0;
 	const int CHANNEL_TWO = 1;
 	PluginWindow::closeAllCurrentlyOpenWindows();
+	// A plugin bypassed for a fault stays bypassed through any rebuild; only
+	// Clear Fault lets it back on the audio thread
+	StringArray faultKeys;
+	Array<int> faultReasons, faultBlocks;
+	for (int i = 0; i < slots.size() && i < slotKeys.size(); i++)
+	{
+		if (!slots[i]->hasFault())
+			continue;
+		faultKeys.add(slotKeys[i]);
+		faultReasons.add(slots[i]->getFaultReason());
+		faultBlocks.add(slots[i]->getNumFaultyBlocks());
+	}
+	slotKeys.clear();
+	{
+		const ScopedLock sl(slotLock);
+		slots.clear();
+	}
     graph.clear();
     inputNode = graph.addNode(new AudioProcessorGraph::AudioGraphIOProcessor(AudioProcessorGraph::AudioGraphIOProcessor::audioInputNode), INPUT);
     outputNode = graph.addNode(new AudioProcessorGraph::AudioGraphIOProcessor(AudioProcessorGraph::AudioGraphIOProcessor::audioOutputNode), OUTPUT);
+	graph.addNode(new MidiInputProcessor(midiInputQueue), MIDI_INPUT);
     if (activePluginList.getNumTypes() == 0)
     {
         graph.addConnection(INPUT, CHANNEL_ONE, OUTPUT, CHANNEL_ONE);
         graph.addConnection(INPUT, CHANNEL_TWO, OUTPUT, CHANNEL_TWO);
     }
+	Array<PluginSlot*> newSlots;
 	int pluginTime = 0;
 	int lastId = 0;
 	bool hasInputConnected = false;
@@ -143,13 +299,38 @@ void IconMenu::loadActivePlugins()
     {
         PluginDescription plugin = getNextPluginOlderThanTime(pluginTime);
         String errorMessage;
-        AudioPluginInstance* instance = formatManager.createPluginInstance(plugin, graph.getSampleRate(), graph.getBlockSize(), errorMessage);
+        AudioPluginInstance* instance;
+		{
+			TRACE_SCOPE_DETAIL("createPluginInstance", plugin.name);
+			instance = formatManager.createPluginInstance(plugin, graph.getSampleRate(), graph.getBlockSize(), errorMessage);
+		}
 		String pluginUid = getKey("state", plugin);
-        String savedPluginState = getAppProperties().getUserSettings()->getValue(pluginUid);
         MemoryBlock savedPluginBinary;
-        savedPluginBinary.fromBase64Encoding(savedPluginState);
-        instance->setStateInformation(savedPluginBinary.getData(), savedPluginBinary.getSize());
-        graph.addNode(instance, i);
+		// After a crash the journal has newer states than the settings file
+		if (!stateJournal.getRecoveredState(pluginUid, savedPluginBinary))
+			savedPluginBinary.fromBase64Encoding(getAppProperties().getUserSettings()->getValue(pluginUid));
+		{
+			TRACE_SCOPE_DETAIL("setStateInformation", plugin.name);
+			instance->setStateInformation(savedPluginBinary.getData(), savedPluginBinary.getSize());
+		}
+		PluginSlot* slot = new PluginSlot(instance);
+		slot->setSanitizing(getAppProperties().getUserSettings()->getBoolValue(getKey("sanitize", plugin), false),
+			(float) getAppProperties().getUserSettings()->getDoubleValue("sanitizeCeiling", 4.0));
+		slot->setAutoBypass(getAppProperties().getUserSettings()->getBoolValue("autoBypassFaults", false));
+		slot->setOversampling(getAppProperties().getUserSettings()->getIntValue(getKey("oversampling", plugin), 1));
+		slot->setWatchdog(getAppProperties().getUserSettings()->getBoolValue("watchdog", false),
+			(float) getAppProperties().getUserSettings()->getDoubleValue("watchdogBudget", 0.8),
+			getAppProperties().getUserSettings()->getIntValue("watchdogOverruns", 3),
+			getAppProperties().getUserSettings()->getDoubleValue("watchdogWindow", 10.0));
+		const int fault = faultKeys.indexOf(pluginUid);
+		if (fault >= 0)
+			slot->restoreFault((PluginSlot::FaultReason) faultReasons[fault], faultBlocks[fault]);
+        graph.addNode(slot, i);
+		newSlots.add(slot);
+		slotKeys.add(pluginUid);
+		// MIDI input to plugin
+		if (slot->acceptsMidi() && getAppProperties().getUserSettings()->getBoolValue(getKey("midi", plugin), true))
+			graph.addConnection(MIDI_INPUT, AudioProcessorGraph::midiChannelIndex, i, AudioProcessorGraph::midiChannelIndex);
 		String key = getKey("bypass", plugin);
 		bool bypass = getAppProperties().getUserSettings()->getBoolValue(key, false);
         // Input to plugin
@@ -168,6 +349,20 @@ void IconMenu::loadActivePlugins()
 		if (!bypass)
 			lastId = i;
     }
+	{
+		const ScopedLock sl(slotLock);
+		slots.swapWith(newSlots);
+	}
+	// Locks every block takes by design, left out of the diagnostics report
+	AudioThreadMonitor::clearExpectedLocks();
+	AudioThreadMonitor::addExpectedLock(graph.getCallbackLock());
+	for (int i = 0; i < graph.getNumNodes(); i++)
+	{
+		AudioProcessor* processor = graph.getNode(i)->getProcessor();
+		AudioThreadMonitor::addExpectedLock(processor->getCallbackLock());
+		if (PluginSlot* slot = dynamic_cast<PluginSlot*>(processor))
+			AudioThreadMonitor::addExpectedLock(slot->getPlugin()->getCallbackLock());
+	}
 	if (lastId > 0)
 	{
 		// Last active plugin to output
@@ -176,6 +371,119 @@ void IconMenu::loadActivePlugins()
 	}
 }
 
+void IconMenu::addPlugin(const PluginDescription& plugin)
+{
+	String key = getKey("order", plugin);
+	int t = time(0);
+	getAppProperties().getUserSettings()->setValue(key, t);
+	getAppProperties().saveIfNeeded();
+	activePluginList.addType(plugin);
+
+	savePluginStates();
+	loadActivePlugins();
+}
+
+void IconMenu::deletePlugin(int index)
+{
+	deletePluginStates();
+
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	String key = getKey("order", timeSorted[index]);
+	int unsortedIndex = -1;
+	for (int i = 0; i < activePluginList.getNumTypes(); i++)
+	{
+		PluginDescription current = *activePluginList.getType(i);
+		if (key.equalsIgnoreCase(getKey("order", current)))
+		{
+			unsortedIndex = i;
+			break;
+		}
+	}
+	if (unsortedIndex < 0)
+		return loadActivePlugins();
+
+	// Remove plugin order
+	getAppProperties().getUserSettings()->removeValue(key);
+	// Remove bypass entry
+	getAppProperties().getUserSettings()->removeValue(getKey("bypass", timeSorted[index]));
+	// Remove sanitize entry
+	getAppProperties().getUserSettings()->removeValue(getKey("sanitize", timeSorted[index]));
+	// Remove MIDI routing entry
+	getAppProperties().getUserSettings()->removeValue(getKey("midi", timeSorted[index]));
+	// Remove oversampling entry
+	getAppProperties().getUserSettings()->removeValue(getKey("oversampling", timeSorted[index]));
+	// Remove morph points
+	getAppProperties().getUserSettings()->removeValue(getKey("morphA", timeSorted[index]));
+	getAppProperties().getUserSettings()->removeValue(getKey("morphB", timeSorted[index]));
+	getAppProperties().saveIfNeeded();
+
+	// Remove plugin from list
+	activePluginList.removeType(unsortedIndex);
+
+	// Save current states
+	savePluginStates();
+	loadActivePlugins();
+}
+
+void IconMenu::setPluginBypass(int index, bool bypass)
+{
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	String key = getKey("bypass", timeSorted[index]);
+
+	// Set bypass flag
+	getAppProperties().getUserSettings()->setValue(key, bypass);
+	getAppProperties().saveIfNeeded();
+
+	savePluginStates();
+	loadActivePlugins();
+}
+
+void IconMenu::movePluginUp(int index)
+{
+	savePluginStates();
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	PluginDescription toMove = timeSorted[index];
+	for (int i = 0; i < timeSorted.size(); i++)
+	{
+		bool move = getKey("move", toMove).equalsIgnoreCase(getKey("move", timeSorted[i]));
+		getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i]), move ? i : i+1);
+		if (move)
+			getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i-1]), i+1);
+	}
+	loadActivePlugins();
+}
+
+void IconMenu::movePluginDown(int index)
+{
+	savePluginStates();
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	PluginDescription toMove = timeSorted[index];
+	for (int i = 0; i < timeSorted.size(); i++)
+	{
+		bool move = getKey("move", toMove).equalsIgnoreCase(getKey("move", timeSorted[i]));
+		getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i]), move ? i+2 : i+1);
+		if (move)
+		{
+			getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i + 1]), i + 1);
+			i++;
+		}
+	}
+	loadActivePlugins();
+}
+
+void IconMenu::movePlugin(int index, int target)
+{
+	savePluginStates();
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	PluginDescription toMove = timeSorted[index];
+	timeSorted.erase(timeSorted.begin() + index);
+	timeSorted.insert(timeSorted.begin() + target, toMove);
+	for (int i = 0; i < timeSorted.size(); i++)
+		getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i]), i + 1);
+	// One rebuild, however far the plugin moves
+	loadActivePlugins();
+}
+
 PluginDescription IconMenu::getNextPluginOlderThanTime(int &time)
 {
 	int timeStatic = time;
@@ -237,12 +545,14 @@ std::string IconMenu::exec(const char* cmd)
 
 void IconMenu::timerCallback()
 {
+	TRACE_SCOPE("timerCallback (menu)");
     stopTimer();
     menu.clear();
     menu.addSectionHeader(JUCEApplication::getInstance()->getApplicationName());
     if (menuIconLeftClicked) {
         menu.addItem(1, "Preferences");
         menu.addItem(2, "Edit Plugins");
+		menu.addItem(3, "Meters");
         menu.addSeparator();
 		menu.addSectionHeader("Active Plugins");
         // Active plugins
@@ -255,16 +565,53 @@ void IconMenu::timerCallback()
 			String key = getKey("bypass", timeSorted[i]);
 			bool bypass = getAppProperties().getUserSettings()->getBoolValue(key);
 			options.addItem(INDEX_BYPASS + i, "Bypass", true, bypass);
+			PluginSlot* slot = getSlot(i);
+			options.addItem(INDEX_SANITIZE + i, "Sanitize Output", true, slot != nullptr && slot->isSanitizing());
+			bool acceptsMidi = slot != nullptr && slot->acceptsMidi();
+			options.addItem(INDEX_MIDI + i, "MIDI Input", acceptsMidi,
+				acceptsMidi && getAppProperties().getUserSettings()->getBoolValue(getKey("midi", timeSorted[i]), true));
+			PopupMenu oversampling;
+			int factor = getAppProperties().getUserSettings()->getIntValue(getKey("oversampling", timeSorted[i]), 1);
+			for (int stage = 0; stage < 4; stage++)
+				oversampling.addItem(INDEX_OVERSAMPLE + i * 4 + stage, stage == 0 ? String("Off") : String(1 << stage) + "x", true, factor == 1 << stage);
+			options.addSubMenu("Oversampling", oversampling);
+			PopupMenu morph;
+			String morphTime = String(getAppProperties().getUserSettings()->getDoubleValue("morphTime", 2.0)) + " s";
+			morph.addItem(INDEX_MORPH + i * 4, "Capture A", slot != nullptr);
+			morph.addItem(INDEX_MORPH + i * 4 + 1, "Capture B", slot != nullptr);
+			morph.addSeparator();
+			morph.addItem(INDEX_MORPH + i * 4 + 2, "Morph to A (" + morphTime + ")",
+				slot != nullptr && getAppProperties().getUserSettings()->containsKey(getKey("morphA", timeSorted[i])));
+			morph.addItem(INDEX_MORPH + i * 4 + 3, "Morph to B (" + morphTime + ")",
+				slot != nullptr && getAppProperties().getUserSettings()->containsKey(getKey("morphB", timeSorted[i])));
+			options.addSubMenu(slot != nullptr && slot->isMorphing() ? "Morph (running)" : "Morph", morph);
+			if (slot != nullptr && slot->hasFault())
+			{
+				StringArray fault;
+				if (slot->getNumFaultyBlocks() > 0)
+					fault.add(String(slot->getNumFaultyBlocks()) + " bad blocks");
+				if (slot->isFaultBypassed())
+					fault.add("bypassed: " + PluginSlot::getFaultDescription(slot->getFaultReason()));
+				if (slot->getFaultReason() == PluginSlot::faultOverBudget)
+					fault.add("peak " + String(roundToInt(slot->getPeakLoad() * 100.0f)) + "% of block");
+				options.addItem(INDEX_CLEAR_FAULT + i, "Clear Fault (" + fault.joinIntoString(", ") + ")");
+			}
 			options.addSeparator();
 			options.addItem(INDEX_MOVE_UP + i, "Move Up", i > 0);
 			options.addItem(INDEX_MOVE_DOWN + i, "Move Down", i < timeSorted.size() - 1);
 			options.addSeparator();
             options.addItem(INDEX_DELETE + i, "Delete");
 			PluginDescription plugin = getNextPluginOlderThanTime(time);
-            menu.addSubMenu(plugin.name, options);
+			bool faulted = slot != nullptr && slot->hasFault();
+            menu.addSubMenu(faulted ? plugin.name + " (!)" : plugin.name, options);
         }
         menu.addSeparator();
 		menu.addSectionHeader("Avaliable Plugins");
+		// Built-in processors
+		PopupMenu builtIn;
+		for (int i = 0; i < internalTypes.size(); i++)
+			builtIn.addItem(INDEX_BUILT_IN + i, internalTypes[i]->name);
+		menu.addSubMenu("Built-in", builtIn);
         // All plugins
         knownPluginList.addToMenu(menu, pluginSortMethod);
     }
@@ -276,6 +623,28 @@ void IconMenu::timerCallback()
 		#if !JUCE_MAC
 			menu.addItem(3, "Invert Icon Color");
 		#endif
+		menu.addItem(4, "Auto-Bypass Faulting Plugins", true,
+			getAppProperties().getUserSettings()->getBoolValue("autoBypassFaults", false));
+		menu.addItem(5, "Control Socket", true, controlServer.isRunning());
+		menu.addItem(11, "Bypass Overrunning or Stalled Plugins", true, watchdog.isRunning());
+		PopupMenu diagnostics;
+		diagnostics.addItem(12, "Record Allocations and Locks", AudioThreadMonitor::isSupported(), audioMonitor.isEnabled());
+		diagnostics.addItem(13, "Save Report", AudioThreadMonitor::isSupported());
+		diagnostics.addItem(14, "Clear Report", AudioThreadMonitor::isSupported());
+		menu.addSubMenu("Audio Thread Diagnostics", diagnostics);
+		PopupMenu trace;
+		trace.addItem(15, "Record", true, Trace::isEnabled());
+		trace.addItem(16, "Export");
+		menu.addSubMenu("Trace", trace);
+		#if JUCE_LINUX
+		PopupMenu lowLatency;
+		RealtimeSupport& realtime = player.getRealtimeSupport();
+		lowLatency.addItem(6, "Enabled", true, realtime.isEnabled());
+		lowLatency.addSeparator();
+		for (int step = 0; step < RealtimeSupport::numSteps; step++)
+			lowLatency.addItem(7 + step, realtime.getDescription((RealtimeSupport::Step) step), false);
+		menu.addSubMenu("Low Latency Mode", lowLatency);
+		#endif
     }
 	#if JUCE_MAC || JUCE_LINUX
     menu.showMenuAsync(PopupMenu::Options().withTargetComponent(this), ModalCallbackFunction::forComponent(menuInvocationCallback, this));
@@ -325,6 +694,54 @@ void IconMenu::menuInvocationCallback(int id, IconMenu* im)
 			getAppProperties().getUserSettings()->setValue("icon", color.equalsIgnoreCase("black") ? "white" : "black");
 			return im->setIcon();
 		}
+		if (id == 4)
+		{
+			bool autoBypass = !getAppProperties().getUserSettings()->getBoolValue("autoBypassFaults", false);
+			getAppProperties().getUserSettings()->setValue("autoBypassFaults", autoBypass);
+			getAppProperties().saveIfNeeded();
+			for (int i = 0; i < im->activePluginList.getNumTypes(); i++)
+				if (PluginSlot* slot = im->getSlot(i))
+					slot->setAutoBypass(autoBypass);
+			return;
+		}
+		if (id == 5)
+		{
+			bool enable = !im->controlServer.isRunning();
+			getAppProperties().getUserSettings()->setValue("controlSocket", enable);
+			getAppProperties().saveIfNeeded();
+			if (enable)
+				return im->startControlServer();
+			return im->controlServer.stop();
+		}
+		if (id == 6)
+		{
+			bool enable = !getAppProperties().getUserSettings()->getBoolValue("lowLatencyMode", false);
+			getAppProperties().getUserSettings()->setValue("lowLatencyMode", enable);
+			getAppProperties().saveIfNeeded();
+			return im->applyLowLatencyMode();
+		}
+		if (id == 11)
+		{
+			bool enable = !getAppProperties().getUserSettings()->getBoolValue("watchdog", false);
+			getAppProperties().getUserSettings()->setValue("watchdog", enable);
+			getAppProperties().saveIfNeeded();
+			return im->applyWatchdog();
+		}
+		if (id == 12)
+		{
+			bool enable = !im->audioMonitor.isEnabled();
+			getAppProperties().getUserSettings()->setValue("audioDiagnostics", enable);
+			getAppProperties().saveIfNeeded();
+			return im->audioMonitor.setEnabled(enable);
+		}
+		if (id == 13)
+			return im->saveAudioThreadReport();
+		if (id == 14)
+			return im->audioMonitor.clear();
+		if (id == 15)
+			return Trace::setEnabled(!Trace::isEnabled());
+		if (id == 16)
+			return im->exportTrace();
     }
 	#if JUCE_MAC
     // Click elsewhere
@@ -337,108 +754,120 @@ void IconMenu::menuInvocationCallback(int id, IconMenu* im)
     // Reload
     if (id == 2)
         im->reloadPlugins();
+    // Meters
+    if (id == 3)
+        im->showMeters();
     // Plugins
-    if (id > 2)
+    if (id > 3)
     {
         // Delete plugin
         if (id >= im->INDEX_DELETE && id < im->INDEX_DELETE + 1000000)
         {
-            im->deletePluginStates();
-
-			int index = id - im->INDEX_DELETE;
-			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
-			String key = getKey("order", timeSorted[index]);
-			int unsortedIndex = 0;
-			for (int i = 0; im->activePluginList.getNumTypes(); i++)
-			{
-				PluginDescription current = *im->activePluginList.getType(i);
-				if (key.equalsIgnoreCase(getKey("order", current)))
-				{
-					unsortedIndex = i;
-					break;
-				}
-			}
-
-			// Remove plugin order
-			getAppProperties().getUserSettings()->removeValue(key);
-			// Remove bypass entry
-			getAppProperties().getUserSettings()->removeValue(getKey("bypass", timeSorted[index]));
-			getAppProperties().saveIfNeeded();
-			
-			// Remove plugin from list
-            im->activePluginList.removeType(unsortedIndex);
-
-			// Save current states
-			im->savePluginStates();
-			im->loadActivePlugins();
+			if (im->isPluginIndex(id - im->INDEX_DELETE))
+				im->deletePlugin(id - im->INDEX_DELETE);
         }
         // Add plugin
         else if (im->knownPluginList.getIndexChosenByMenu(id) > -1)
         {
-			PluginDescription plugin = *im->knownPluginList.getType(im->knownPluginList.getIndexChosenByMenu(id));
-			String key = getKey("order", plugin);
-			int t = time(0);
-			getAppProperties().getUserSettings()->setValue(key, t);
-			getAppProperties().saveIfNeeded();
-            im->activePluginList.addType(plugin);
-
-			im->savePluginStates();
-			im->loadActivePlugins();
+			im->addPlugin(*im->knownPluginList.getType(im->knownPluginList.getIndexChosenByMenu(id)));
         }
+		// Add built-in processor
+		else if (id >= im->INDEX_BUILT_IN && id < im->INDEX_BUILT_IN + im->internalTypes.size())
+		{
+			im->addPlugin(*im->internalTypes[id - im->INDEX_BUILT_IN]);
+		}
 		// Bypass plugin
 		else if (id >= im->INDEX_BYPASS && id < im->INDEX_BYPASS + 1000000)
 		{
 			int index = id - im->INDEX_BYPASS;
+			if (!im->isPluginIndex(index))
+				return;
+			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
+			bool bypassed = getAppProperties().getUserSettings()->getBoolValue(getKey("bypass", timeSorted[index]));
+			im->setPluginBypass(index, !bypassed);
+		}
+		// Toggle output sanitization
+		else if (id >= im->INDEX_SANITIZE && id < im->INDEX_SANITIZE + 1000000)
+		{
+			int index = id - im->INDEX_SANITIZE;
+			if (!im->isPluginIndex(index))
+				return;
 			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
-			String key = getKey("bypass", timeSorted[index]);
+			String key = getKey("sanitize", timeSorted[index]);
 
-			// Set bypass flag
-			bool bypassed = getAppProperties().getUserSettings()->getBoolValue(key);
-			getAppProperties().getUserSettings()->setValue(key, !bypassed);
+			bool sanitize = !getAppProperties().getUserSettings()->getBoolValue(key, false);
+			getAppProperties().getUserSettings()->setValue(key, sanitize);
+			getAppProperties().saveIfNeeded();
+
+			if (PluginSlot* slot = im->getSlot(index))
+				slot->setSanitizing(sanitize, (float) getAppProperties().getUserSettings()->getDoubleValue("sanitizeCeiling", 4.0));
+		}
+		// Toggle MIDI input routing
+		else if (id >= im->INDEX_MIDI && id < im->INDEX_MIDI + 1000000)
+		{
+			int index = id - im->INDEX_MIDI;
+			if (!im->isPluginIndex(index))
+				return;
+			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
+			String key = getKey("midi", timeSorted[index]);
+
+			bool midi = getAppProperties().getUserSettings()->getBoolValue(key, true);
+			getAppProperties().getUserSettings()->setValue(key, !midi);
+			getAppProperties().saveIfNeeded();
+
+			im->savePluginStates();
+			im->loadActivePlugins();
+		}
+		// Oversampling factor; the slot is prepared again at the new rate
+		else if (id >= im->INDEX_OVERSAMPLE && id < im->INDEX_OVERSAMPLE + 1000000)
+		{
+			int index = (id - im->INDEX_OVERSAMPLE) / 4;
+			int factor = 1 << ((id - im->INDEX_OVERSAMPLE) % 4);
+			if (!im->isPluginIndex(index))
+				return;
+			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
+			getAppProperties().getUserSettings()->setValue(getKey("oversampling", timeSorted[index]), factor);
 			getAppProperties().saveIfNeeded();
 
 			im->savePluginStates();
 			im->loadActivePlugins();
 		}
+		// Capture a morph point or glide to one
+		else if (id >= im->INDEX_MORPH && id < im->INDEX_MORPH + 1000000)
+		{
+			int index = (id - im->INDEX_MORPH) / 4;
+			int action = (id - im->INDEX_MORPH) % 4;
+			if (!im->isPluginIndex(index))
+				return;
+			if (action < 2)
+				im->captureMorphPoint(index, action);
+			else
+				im->morphPlugin(index, action - 2, -1.0);
+		}
+		// Re-enable a plugin that was flagged or bypassed for bad output
+		else if (id >= im->INDEX_CLEAR_FAULT && id < im->INDEX_CLEAR_FAULT + 1000000)
+		{
+			if (PluginSlot* slot = im->isPluginIndex(id - im->INDEX_CLEAR_FAULT) ? im->getSlot(id - im->INDEX_CLEAR_FAULT) : nullptr)
+				slot->clearFault();
+		}
         // Show active plugin GUI
 		else if (id >= im->INDEX_EDIT && id < im->INDEX_EDIT + 1000000)
         {
-            if (const AudioProcessorGraph::Node::Ptr f = im->graph.getNodeForId(id - im->INDEX_EDIT + 1))
+            if (const AudioProcessorGraph::Node::Ptr f = im->isPluginIndex(id - im->INDEX_EDIT) ? im->graph.getNodeForId(id - im->INDEX_EDIT + 1) : nullptr)
                 if (PluginWindow* const w = PluginWindow::getWindowFor(f, PluginWindow::Normal))
                     w->toFront(true);
         }
 		// Move plugin up the list
 		else if (id >= im->INDEX_MOVE_UP && id < im->INDEX_MOVE_UP + 1000000)
 		{
-			im->savePluginStates();
-			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
-			PluginDescription toMove = timeSorted[id - im->INDEX_MOVE_UP];
-			for (int i = 0; i < timeSorted.size(); i++)
-			{
-				bool move = getKey("move", toMove).equalsIgnoreCase(getKey("move", timeSorted[i]));
-				getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i]), move ? i : i+1);
-				if (move)
-					getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i-1]), i+1);
-			}
-			im->loadActivePlugins();
+			if (im->isPluginIndex(id - im->INDEX_MOVE_UP) && id > im->INDEX_MOVE_UP)
+				im->movePluginUp(id - im->INDEX_MOVE_UP);
 		}
 		// Move plugin down the list
 		else if (id >= im->INDEX_MOVE_DOWN && id < im->INDEX_MOVE_DOWN + 1000000)
 		{
-			im->savePluginStates();
-			std::vector<PluginDescription> timeSorted = im->getTimeSortedList();
-			PluginDescription toMove = timeSorted[id - im->INDEX_MOVE_DOWN];
-			for (int i = 0; i < timeSorted.size(); i++)
-			{
-				bool move = getKey("move", toMove).equalsIgnoreCase(getKey("move", timeSorted[i]));
-				getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i]), move ? i+2 : i+1);
-				if (move)
-				{
-					getAppProperties().getUserSettings()->setValue(getKey("order", timeSorted[i + 1]), i + 1);
-					i++;
-				}
-			}
-			im->loadActivePlugins();
+			if (im->isPluginIndex(id - im->INDEX_MOVE_DOWN + 1))
+				im->movePluginDown(id - im->INDEX_MOVE_DOWN);
 		}
         // Update menu
         im->startTimer(50);
@@ -455,6 +884,20 @@ std::vector<PluginDescription> IconMenu::getTimeSortedList()
 		
 }
 
+PluginSlot* IconMenu::getSlot(int index)
+{
+	if (AudioProcessorGraph::Node* node = graph.getNodeForId(index + 1))
+		return dynamic_cast<PluginSlot*>(node->getProcessor());
+	return nullptr;
+}
+
+// Menu items carry the chain index they were built for, and the control
+// socket can change the chain while the menu is open
+bool IconMenu::isPluginIndex(int index) const
+{
+	return index >= 0 && index < activePluginList.getNumTypes();
+}
+
 String IconMenu::getKey(String type, PluginDescription plugin)
 {
 	String key = "plugin-" + type.toLowerCase() + "-" + plugin.name + plugin.version + plugin.pluginFormatName;
@@ -470,10 +913,13 @@ void IconMenu::deletePluginStates()
         getAppProperties().getUserSettings()->removeValue(pluginUid);
         getAppProperties().saveIfNeeded();
     }
+	// Journalled states would otherwise come back after a crash
+	stateJournal.checkpoint();
 }
 
 void IconMenu::savePluginStates()
 {
+	TRACE_SCOPE("savePluginStates");
 	std::vector<PluginDescription> list = getTimeSortedList();
     for (int i = 0; i < activePluginList.getNumTypes(); i++)
     {
@@ -487,11 +933,25 @@ void IconMenu::savePluginStates()
         getAppProperties().getUserSettings()->setValue(pluginUid, savedStateBinary.toBase64Encoding());
         getAppProperties().saveIfNeeded();
     }
+	stateJournal.checkpoint();
+}
+
+void IconMenu::getJournalStates(StringArray& keys, OwnedArray<MemoryBlock>& states)
+{
+	std::vector<PluginDescription> list = getTimeSortedList();
+	for (int i = 0; i < activePluginList.getNumTypes(); i++)
+	{
+		AudioProcessorGraph::Node* node = graph.getNodeForId(i + 1);
+		if (node == nullptr)
+			break;
+		keys.add(getKey("state", list[i]));
+		node->getProcessor()->getStateInformation(*states.add(new MemoryBlock()));
+	}
 }
 
 void IconMenu::showAudioSettings()
 {
-    AudioDeviceSelectorComponent audioSettingsComp (deviceManager, 0, 256, 0, 256, false, false, true, true);
+    AudioDeviceSelectorComponent audioSettingsComp (deviceManager, 0, 256, 0, 256, true, false, true, true);
     audioSettingsComp.setSize(500, 450);
     
     DialogWindow::LaunchOptions o;
@@ -511,6 +971,225 @@ void IconMenu::showAudioSettings()
     getAppProperties().getUserSettings()->saveIfNeeded();
 }
 
+void IconMenu::startControlServer()
+{
+	String path = getAppProperties().getUserSettings()->getValue("controlSocketPath");
+	File socketFile = path.isNotEmpty() ? File(path) : getAppProperties().getUserSettings()->getFile().withFileExtension("sock");
+	if (!controlServer.start(socketFile))
+		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Control Socket", controlServer.getLastError());
+}
+
+void IconMenu::applyLowLatencyMode()
+{
+	PropertiesFile* settings = getAppProperties().getUserSettings();
+	RealtimeSupport& realtime = player.getRealtimeSupport();
+	bool enable = settings->getBoolValue("lowLatencyMode", false);
+	realtime.configure(enable, settings->getIntValue("realtimePriority", 70), settings->getValue("audioCpus"));
+	if (enable)
+		realtime.lockMemory();
+	else
+		realtime.unlockMemory();
+	// Restarting moves the callback onto a fresh thread, which picks up the
+	// new scheduling, and pre-faults the graph as the device starts.
+	deviceManager.closeAudioDevice();
+	deviceManager.restartLastAudioDevice();
+}
+
+void IconMenu::applyWatchdog()
+{
+	PropertiesFile* settings = getAppProperties().getUserSettings();
+	bool enable = settings->getBoolValue("watchdog", false);
+	for (int i = 0; i < activePluginList.getNumTypes(); i++)
+		if (PluginSlot* slot = getSlot(i))
+			slot->setWatchdog(enable, (float) settings->getDoubleValue("watchdogBudget", 0.8),
+				settings->getIntValue("watchdogOverruns", 3), settings->getDoubleValue("watchdogWindow", 10.0));
+	if (enable)
+		watchdog.start(settings->getDoubleValue("watchdogStall", 1.0));
+	else
+		watchdog.stop();
+}
+
+void IconMenu::saveAudioThreadReport()
+{
+	File report = getAppProperties().getUserSettings()->getFile().withFileExtension("diagnostics.txt");
+	if (report.replaceWithText(audioMonitor.createReport()))
+		report.revealToUser();
+	else
+		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Audio Thread Diagnostics",
+			"Could not write " + report.getFullPathName());
+}
+
+void IconMenu::exportTrace()
+{
+	File file = getAppProperties().getUserSettings()->getFile().withFileExtension("trace.json");
+	if (Trace::exportJson(file))
+		file.revealToUser();
+	else
+		AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Trace", "Could not write " + file.getFullPathName());
+}
+
+const PluginDescription* IconMenu::findPlugin(const String& name)
+{
+	for (int i = 0; i < internalTypes.size(); i++)
+		if (internalTypes[i]->name.equalsIgnoreCase(name))
+			return internalTypes[i];
+	for (int i = 0; i < knownPluginList.getNumTypes(); i++)
+		if (knownPluginList.getType(i)->name.equalsIgnoreCase(name)
+			|| knownPluginList.getType(i)->fileOrIdentifier == name)
+			return knownPluginList.getType(i);
+	return nullptr;
+}
+
+void IconMenu::handleControlCommand(const StringArray& tokens, StringArray& reply)
+{
+	const String command = tokens[0];
+	const int numPlugins = activePluginList.getNumTypes();
+	const int index = tokens[1].getIntValue();
+	const bool validIndex = tokens.size() > 1 && index >= 0 && index < numPlugins;
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+
+	if (command == "list")
+	{
+		for (int i = 0; i < numPlugins; i++)
+		{
+			bool bypass = getAppProperties().getUserSettings()->getBoolValue(getKey("bypass", timeSorted[i]));
+			reply.add("plugin " + String(i) + " " + String(bypass ? 1 : 0) + " " + timeSorted[i].name);
+		}
+	}
+	else if (command == "bypass" && validIndex && tokens.size() == 3)
+		setPluginBypass(index, tokens[2].getIntValue() != 0);
+	else if (command == "move" && validIndex && tokens.size() == 3)
+	{
+		const int target = jlimit(0, numPlugins - 1, tokens[2].getIntValue());
+		if (target != index)
+		{
+			PopupMenu::dismissAllActiveMenus();
+			movePlugin(index, target);
+		}
+	}
+	else if (command == "add" && tokens.size() >= 2)
+	{
+		const String name = tokens.joinIntoString(" ", 1);
+		const PluginDescription* plugin = findPlugin(name);
+		if (plugin == nullptr)
+			return reply.add("error unknown plugin: " + name);
+		PopupMenu::dismissAllActiveMenus();
+		addPlugin(*plugin);
+	}
+	else if (command == "delete" && validIndex)
+	{
+		PopupMenu::dismissAllActiveMenus();
+		deletePlugin(index);
+	}
+	else if (command == "snapshot")
+		savePluginStates();
+	else if ((command == "params" || command == "get") && validIndex)
+	{
+		PluginSlot* slot = getSlot(index);
+		if (slot == nullptr)
+			return reply.add("error plugin not loaded");
+		AudioPluginInstance* plugin = slot->getPlugin();
+		if (command == "params")
+		{
+			for (int i = 0; i < plugin->getNumParameters(); i++)
+				reply.add("param " + String(i) + " " + String(plugin->getParameter(i)) + " " + plugin->getParameterName(i));
+		}
+		else
+		{
+			const int parameter = tokens[2].getIntValue();
+			if (tokens.size() != 3 || parameter < 0 || parameter >= plugin->getNumParameters())
+				return reply.add("error no such parameter");
+			reply.add("value " + String(plugin->getParameter(parameter)));
+		}
+	}
+	else if ((command == "capture" || command == "morph") && validIndex && tokens.size() >= 3
+		&& (tokens[2].equalsIgnoreCase("a") || tokens[2].equalsIgnoreCase("b")))
+	{
+		const int point = tokens[2].equalsIgnoreCase("a") ? 0 : 1;
+		if (command == "capture")
+			captureMorphPoint(index, point);
+		else if (!morphPlugin(index, point, tokens.size() > 3 ? tokens[3].getDoubleValue() : -1.0))
+			return reply.add("error plugin not loaded or point not captured");
+	}
+	else if (command == "meters")
+	{
+		Array<const LevelMeter*> meters;
+		StringArray names;
+		getMeterTaps(meters, names);
+		for (int i = 0; i < meters.size(); i++)
+			reply.add("meter " + String(Decibels::gainToDecibels(meters[i]->getPeak()), 1)
+				+ " " + String(Decibels::gainToDecibels(meters[i]->getRms()), 1)
+				+ " " + String(meters[i]->getLoudness(), 1) + " " + names[i]);
+	}
+	else if (command == "status")
+		reply.add("status " + String(numPlugins) + " " + String(midiInputQueue.getNumDropped()));
+	else
+		return reply.add("error unknown command or bad arguments: " + tokens.joinIntoString(" "));
+	reply.add("ok");
+}
+
+void IconMenu::captureMorphPoint(int index, int point)
+{
+	PluginSlot* slot = getSlot(index);
+	if (slot == nullptr)
+		return;
+	StringArray values;
+	for (int i = 0; i < slot->getNumParameters(); i++)
+		values.add(String(slot->getParameter(i)));
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	getAppProperties().getUserSettings()->setValue(getKey(point == 0 ? "morphA" : "morphB", timeSorted[index]), values.joinIntoString(" "));
+	getAppProperties().saveIfNeeded();
+}
+
+bool IconMenu::morphPlugin(int index, int point, double seconds)
+{
+	if (index < 0 || index >= activePluginList.getNumTypes())
+		return false;
+	PluginSlot* slot = getSlot(index);
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	StringArray values;
+	values.addTokens(getAppProperties().getUserSettings()->getValue(getKey(point == 0 ? "morphA" : "morphB", timeSorted[index])), " ", String());
+	values.removeEmptyStrings();
+	if (slot == nullptr || values.isEmpty())
+		return false;
+	Array<float> target;
+	for (int i = 0; i < values.size(); i++)
+		target.add(values[i].getFloatValue());
+	slot->morphTo(target, seconds >= 0.0 ? seconds : getAppProperties().getUserSettings()->getDoubleValue("morphTime", 2.0));
+	return true;
+}
+
+bool IconMenu::queueParameterChange(int pluginIndex, int parameterIndex, float value)
+{
+	const ScopedLock sl(slotLock);
+	PluginSlot* slot = slots[pluginIndex];
+	return slot != nullptr && slot->queueParameterChange(parameterIndex, value);
+}
+
+void IconMenu::showMeters()
+{
+	if (meterWindow == nullptr)
+		meterWindow = new MeterWindow(*this);
+	meterWindow->toFront(true);
+}
+
+void IconMenu::getMeterTaps(Array<const LevelMeter*>& meters, StringArray& names)
+{
+	meters.add(&player.getInputMeter());
+	names.add("Input");
+	std::vector<PluginDescription> timeSorted = getTimeSortedList();
+	for (int i = 0; i < (int) timeSorted.size(); i++)
+	{
+		if (PluginSlot* slot = getSlot(i))
+		{
+			meters.add(&slot->getMeter());
+			names.add(timeSorted[i].name);
+		}
+	}
+	meters.add(&player.getOutputMeter());
+	names.add("Output");
+}
+
 void IconMenu::reloadPlugins()
 {
 	if (pluginListWindow == nullptr)
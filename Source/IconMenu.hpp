@@ -9,9 +9,18 @@
 #ifndef IconMenu_hpp
 #define IconMenu_hpp
 
+#include "HostAudioPlayer.h"
+#include "InternalPlugins.h"
+#include "ControlServer.h"
+#include "MidiInputQueue.h"
+#include "PluginWatchdog.h"
+#include "AudioThreadMonitor.h"
+#include "StateJournal.h"
+
+class PluginSlot;
 ApplicationProperties& getAppProperties();
 
-class IconMenu : public SystemTrayIconComponent, private Timer, public ChangeListener
+class IconMenu : public SystemTrayIconComponent, private Timer, public ChangeListener, private ControlServer::Handler, private StateJournal::Source
 {
 public:
     IconMenu();
@@ -20,8 +29,12 @@ public:
     static void menuInvocationCallback(int id, IconMenu*);
     void changeListenerCallback(ChangeBroadcaster* changed);
 	static String getKey(String type, PluginDescription plugin);
+	void getMeterTaps(Array<const LevelMeter*>& meters, StringArray& names);
+	// point is 0 for A, 1 for B; a negative time uses the morphTime setting
+	void captureMorphPoint(int index, int point);
+	bool morphPlugin(int index, int point, double seconds);
 
-	const int INDEX_EDIT, INDEX_BYPASS, INDEX_DELETE, INDEX_MOVE_UP, INDEX_MOVE_DOWN;
+	const int INDEX_EDIT, INDEX_BYPASS, INDEX_DELETE, INDEX_MOVE_UP, INDEX_MOVE_DOWN, INDEX_SANITIZE, INDEX_CLEAR_FAULT, INDEX_BUILT_IN, INDEX_MIDI, INDEX_OVERSAMPLE, INDEX_MORPH;
 private:
 	#if JUCE_MAC
     std::string exec(const char* cmd);
@@ -29,32 +42,65 @@ private:
     void timerCallback();
     void reloadPlugins();
     void showAudioSettings();
+	void showMeters();
     void loadActivePlugins();
+	void addPlugin(const PluginDescription& plugin);
+	void deletePlugin(int index);
+	void setPluginBypass(int index, bool bypass);
+	void movePluginUp(int index);
+	void movePluginDown(int index);
+	void movePlugin(int index, int target);
     void savePluginStates();
     void deletePluginStates();
 	PluginDescription getNextPluginOlderThanTime(int &time);
 	void removePluginsLackingInputOutput();
 	std::vector<PluginDescription> getTimeSortedList();
 	void setIcon();
+	void startControlServer();
+	void applyLowLatencyMode();
+	void applyWatchdog();
+	void saveAudioThreadReport();
+	void exportTrace();
+	const PluginDescription* findPlugin(const String& name);
+	void handleControlCommand(const StringArray& tokens, StringArray& reply) override;
+	bool queueParameterChange(int pluginIndex, int parameterIndex, float value) override;
+	void getJournalStates(StringArray& keys, OwnedArray<MemoryBlock>& states) override;
+	PluginSlot* getSlot(int index);
+	bool isPluginIndex(int index) const;
     
     AudioDeviceManager deviceManager;
     AudioPluginFormatManager formatManager;
+	InternalPluginFormat* internalFormat;
+	OwnedArray<PluginDescription> internalTypes;
     KnownPluginList knownPluginList;
     KnownPluginList activePluginList;
     KnownPluginList::SortMethod pluginSortMethod;
     PopupMenu menu;
     ScopedPointer<PluginDirectoryScanner> scanner;
     bool menuIconLeftClicked;
+	// Declared before the graph, which holds a reference to it
+	MidiInputQueue midiInputQueue;
     AudioProcessorGraph graph;
-    AudioProcessorPlayer player;
+    HostAudioPlayer player;
     AudioProcessorGraph::Node *inputNode;
     AudioProcessorGraph::Node *outputNode;
+	ControlServer controlServer;
+	// Slots in chain order, for threads that cannot look them up in the graph
+	CriticalSection slotLock;
+	Array<PluginSlot*> slots;
+	// Message thread only: the state key of each slot, so faults survive a rebuild
+	StringArray slotKeys;
+	PluginWatchdog watchdog;
+	AudioThreadMonitor audioMonitor;
+	StateJournal stateJournal;
 	#if JUCE_WINDOWS
 	int x, y;
 	#endif
 
 	class PluginListWindow;
 	ScopedPointer<PluginListWindow> pluginListWindow;
+	class MeterWindow;
+	ScopedPointer<MeterWindow> meterWindow;
 };
 
 #endif /* IconMenu_hpp */
@@ -0,0 +1,247 @@
+//
+//  InternalPlugins.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "InternalPlugins.h"
+#include "VectorOps.h"
+#include <cmath>
+
+// Base for the built-in processors: stereo in/out, no editor, parameters
+// saved by id so the generic editor and plugin states both work.
+class InternalPlugin : public AudioPluginInstance
+{
+public:
+	InternalPlugin(const PluginDescription& d) : description(d), sampleRate(44100.0)
+	{
+		setPlayConfigDetails(2, 2, sampleRate, 512);
+	}
+
+	const String getName() const override                           { return description.name; }
+	void fillInPluginDescription(PluginDescription& d) const override { d = description; }
+
+	void prepareToPlay(double newSampleRate, int) override          { sampleRate = newSampleRate; reset(); }
+	void releaseResources() override                                {}
+	double getTailLengthSeconds() const override                    { return 0.0; }
+	bool acceptsMidi() const override                               { return false; }
+	bool producesMidi() const override                              { return false; }
+
+	AudioProcessorEditor* createEditor() override                   { return nullptr; }
+	bool hasEditor() const override                                 { return false; }
+
+	int getNumPrograms() override                                   { return 1; }
+	int getCurrentProgram() override                                { return 0; }
+	void setCurrentProgram(int) override                            {}
+	const String getProgramName(int) override                       { return String(); }
+	void changeProgramName(int, const String&) override             {}
+
+	void getStateInformation(MemoryBlock& destData) override
+	{
+		XmlElement xml("INTERNALPLUGIN");
+		const OwnedArray<AudioProcessorParameter>& parameters = getParameters();
+		for (int i = 0; i < parameters.size(); i++)
+			if (AudioProcessorParameterWithID* p = dynamic_cast<AudioProcessorParameterWithID*>(parameters.getUnchecked(i)))
+				xml.setAttribute(p->paramID, p->getValue());
+		copyXmlToBinary(xml, destData);
+	}
+
+	void setStateInformation(const void* data, int sizeInBytes) override
+	{
+		ScopedPointer<XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
+		if (xml == nullptr)
+			return;
+		const OwnedArray<AudioProcessorParameter>& parameters = getParameters();
+		for (int i = 0; i < parameters.size(); i++)
+			if (AudioProcessorParameterWithID* p = dynamic_cast<AudioProcessorParameterWithID*>(parameters.getUnchecked(i)))
+				p->setValueNotifyingHost((float) xml->getDoubleValue(p->paramID, p->getValue()));
+	}
+
+protected:
+	const PluginDescription description;
+	double sampleRate;
+
+private:
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InternalPlugin)
+};
+
+//==============================================================================
+class GainTrimProcessor : public InternalPlugin
+{
+public:
+	GainTrimProcessor(const PluginDescription& d) : InternalPlugin(d), currentGain(1.0f)
+	{
+		addParameter(gain = new AudioParameterFloat("gain", "Gain (dB)", NormalisableRange<float>(-24.0f, 24.0f), 0.0f));
+	}
+
+	void reset() override
+	{
+		currentGain = Decibels::decibelsToGain(gain->get());
+	}
+
+	void processBlock(AudioBuffer<float>& buffer, MidiBuffer&) override
+	{
+		// Ramp over the block so parameter moves do not click
+		const float targetGain = Decibels::decibelsToGain(gain->get());
+		for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+			VectorOps::applyGainRamp(buffer.getWritePointer(channel), buffer.getNumSamples(), currentGain, targetGain);
+		currentGain = targetGain;
+	}
+
+private:
+	AudioParameterFloat* gain;
+	float currentGain;
+};
+
+//==============================================================================
+class PolarityFlipProcessor : public InternalPlugin
+{
+public:
+	PolarityFlipProcessor(const PluginDescription& d) : InternalPlugin(d)
+	{
+		addParameter(invert[0] = new AudioParameterBool("left", "Invert Left", true));
+		addParameter(invert[1] = new AudioParameterBool("right", "Invert Right", true));
+		reset();
+	}
+
+	void reset() override
+	{
+		for (int channel = 0; channel < 2; channel++)
+			currentSign[channel] = invert[channel]->get() ? -1.0f : 1.0f;
+	}
+
+	void processBlock(AudioBuffer<float>& buffer, MidiBuffer&) override
+	{
+		// Toggling crossfades through silence rather than stepping
+		for (int channel = 0; channel < jmin(2, buffer.getNumChannels()); channel++)
+		{
+			const float targetSign = invert[channel]->get() ? -1.0f : 1.0f;
+			float* data = buffer.getWritePointer(channel);
+			if (currentSign[channel] != targetSign)
+				VectorOps::applyGainRamp(data, buffer.getNumSamples(), currentSign[channel], targetSign);
+			else if (targetSign < 0.0f)
+				FloatVectorOperations::negate(data, data, buffer.getNumSamples());
+			currentSign[channel] = targetSign;
+		}
+	}
+
+private:
+	AudioParameterBool* invert[2];
+	float currentSign[2];
+};
+
+//==============================================================================
+class ChannelSwapProcessor : public InternalPlugin
+{
+public:
+	ChannelSwapProcessor(const PluginDescription& d) : InternalPlugin(d) {}
+
+	void reset() override {}
+
+	void processBlock(AudioBuffer<float>& buffer, MidiBuffer&) override
+	{
+		if (buffer.getNumChannels() >= 2)
+			VectorOps::swap(buffer.getWritePointer(0), buffer.getWritePointer(1), buffer.getNumSamples());
+	}
+};
+
+//==============================================================================
+// Block-based peak limiter: the gain drops to the block's required reduction
+// over one block and recovers with the release time. A hard clip at the
+// ceiling catches whatever the ramp lets through.
+class SafetyLimiterProcessor : public InternalPlugin
+{
+public:
+	SafetyLimiterProcessor(const PluginDescription& d) : InternalPlugin(d), currentGain(1.0f)
+	{
+		addParameter(ceiling = new AudioParameterFloat("ceiling", "Ceiling (dB)", NormalisableRange<float>(-24.0f, 0.0f), -0.3f));
+		addParameter(release = new AudioParameterFloat("release", "Release (ms)", NormalisableRange<float>(10.0f, 1000.0f), 100.0f));
+	}
+
+	void reset() override
+	{
+		currentGain = 1.0f;
+	}
+
+	void processBlock(AudioBuffer<float>& buffer, MidiBuffer&) override
+	{
+		const int numSamples = buffer.getNumSamples();
+		if (numSamples <= 0)
+			return;
+		const float ceilingGain = Decibels::decibelsToGain(ceiling->get());
+
+		float peak = 0.0f;
+		for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+		{
+			const Range<float> range = FloatVectorOperations::findMinAndMax(buffer.getReadPointer(channel), numSamples);
+			peak = jmax(peak, -range.getStart(), range.getEnd());
+		}
+
+		const float targetGain = peak > ceilingGain ? ceilingGain / peak : 1.0f;
+		float nextGain = targetGain;
+		if (targetGain > currentGain)
+		{
+			const double releaseSamples = release->get() * 0.001 * sampleRate;
+			nextGain = currentGain + (targetGain - currentGain) * (float) (1.0 - std::exp(-numSamples / releaseSamples));
+		}
+
+		for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+		{
+			float* data = buffer.getWritePointer(channel);
+			VectorOps::applyGainRamp(data, numSamples, currentGain, nextGain);
+			VectorOps::sanitize(data, numSamples, ceilingGain);
+		}
+		currentGain = nextGain;
+	}
+
+private:
+	AudioParameterFloat* ceiling;
+	AudioParameterFloat* release;
+	float currentGain;
+};
+
+//==============================================================================
+InternalPluginFormat::InternalPluginFormat()
+{
+	const char* const names[numInternalPluginTypes] = { "Gain Trim", "Polarity Flip", "Channel Swap", "Safety Limiter" };
+	for (int i = 0; i < numInternalPluginTypes; i++)
+	{
+		PluginDescription& d = descriptions[i];
+		d.name = names[i];
+		d.descriptiveName = names[i];
+		d.fileOrIdentifier = names[i];
+		d.pluginFormatName = getName();
+		d.category = "Utility";
+		d.manufacturerName = "Light Host";
+		// Part of the state key, so this must not follow the app version
+		d.version = "1.0";
+		d.uid = d.name.hashCode();
+		d.isInstrument = false;
+		d.numInputChannels = 2;
+		d.numOutputChannels = 2;
+	}
+}
+
+void InternalPluginFormat::getAllTypes(OwnedArray<PluginDescription>& results) const
+{
+	for (int i = 0; i < numInternalPluginTypes; i++)
+		results.add(new PluginDescription(descriptions[i]));
+}
+
+void InternalPluginFormat::createPluginInstance(const PluginDescription& desc, double initialSampleRate, int initialBufferSize,
+	void* userData, void (*callback)(void*, AudioPluginInstance*, const String&))
+{
+	AudioPluginInstance* instance = nullptr;
+	if (desc.name == descriptions[gainTrim].name)
+		instance = new GainTrimProcessor(descriptions[gainTrim]);
+	else if (desc.name == descriptions[polarityFlip].name)
+		instance = new PolarityFlipProcessor(descriptions[polarityFlip]);
+	else if (desc.name == descriptions[channelSwap].name)
+		instance = new ChannelSwapProcessor(descriptions[channelSwap]);
+	else if (desc.name == descriptions[safetyLimiter].name)
+		instance = new SafetyLimiterProcessor(descriptions[safetyLimiter]);
+
+	if (instance != nullptr)
+		instance->setPlayConfigDetails(2, 2, initialSampleRate, initialBufferSize);
+	callback(userData, instance, instance == nullptr ? "Unknown internal plugin: " + desc.name : String());
+}
@@ -0,0 +1,49 @@
+//
+//  InternalPlugins.h
+//  Light Host
+//
+//  Built-in utility processors. They are exposed through a plugin format so
+//  the rest of the host loads, orders and saves them like any other plugin.
+//
+
+#ifndef InternalPlugins_h
+#define InternalPlugins_h
+
+class InternalPluginFormat : public AudioPluginFormat
+{
+public:
+	enum InternalPluginType
+	{
+		gainTrim = 0,
+		polarityFlip,
+		channelSwap,
+		safetyLimiter,
+		numInternalPluginTypes
+	};
+
+	InternalPluginFormat();
+	~InternalPluginFormat() {}
+
+	void getAllTypes(OwnedArray<PluginDescription>& results) const;
+
+	String getName() const override                                     { return "Internal"; }
+	bool fileMightContainThisPluginType(const String&) override         { return true; }
+	FileSearchPath getDefaultLocationsToSearch() override               { return FileSearchPath(); }
+	bool canScanForPlugins() const override                             { return false; }
+	void findAllTypesForFile(OwnedArray<PluginDescription>&, const String&) override {}
+	bool doesPluginStillExist(const PluginDescription&) override        { return true; }
+	String getNameOfPluginFromIdentifier(const String& fileOrIdentifier) override { return fileOrIdentifier; }
+	bool pluginNeedsRescanning(const PluginDescription&) override       { return false; }
+	StringArray searchPathsForPlugins(const FileSearchPath&, bool, bool) override { return StringArray(); }
+
+private:
+	void createPluginInstance(const PluginDescription&, double initialSampleRate, int initialBufferSize,
+		void* userData, void (*callback)(void*, AudioPluginInstance*, const String&)) override;
+	bool requiresUnblockedMessageThreadDuringCreation(const PluginDescription&) const noexcept override { return false; }
+
+	PluginDescription descriptions[numInternalPluginTypes];
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(InternalPluginFormat)
+};
+
+#endif /* InternalPlugins_h */
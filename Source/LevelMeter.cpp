@@ -0,0 +1,124 @@
+//
+//  LevelMeter.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LevelMeter.h"
+#include "VectorOps.h"
+#include <cmath>
+
+static const float silenceLoudness = -100.0f;
+
+LevelMeter::LevelMeter() : peak(0.0f), rms(0.0f), loudness(silenceLoudness)
+{
+	prepare(44100.0);
+}
+
+void LevelMeter::prepare(double newSampleRate)
+{
+	sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+
+	// ITU-R BS.1770 K-weighting, recomputed for the actual sample rate
+	{
+		const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+		const double k = std::tan(double_Pi * f0 / sampleRate);
+		const double vh = std::pow(10.0, gainDb / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		const double a0 = 1.0 + k / q + k * k;
+		shelf.b0 = (float) ((vh + vb * k / q + k * k) / a0);
+		shelf.b1 = (float) (2.0 * (k * k - vh) / a0);
+		shelf.b2 = (float) ((vh - vb * k / q + k * k) / a0);
+		shelf.a1 = (float) (2.0 * (k * k - 1.0) / a0);
+		shelf.a2 = (float) ((1.0 - k / q + k * k) / a0);
+	}
+	{
+		const double f0 = 38.13547087602444, q = 0.5003270373238773;
+		const double k = std::tan(double_Pi * f0 / sampleRate);
+		const double a0 = 1.0 + k / q + k * k;
+		highPass.b0 = 1.0f;
+		highPass.b1 = -2.0f;
+		highPass.b2 = 1.0f;
+		highPass.a1 = (float) (2.0 * (k * k - 1.0) / a0);
+		highPass.a2 = (float) ((1.0 - k / q + k * k) / a0);
+	}
+
+	zeromem(state, sizeof(state));
+	peakHold = meanSquare = 0.0f;
+	subBlockEnergy = 0.0;
+	subBlockSamples = subBlockIndex = 0;
+	subBlockLength = jmax(1, roundToInt(sampleRate * 0.1));
+	for (int i = 0; i < 4; i++)
+		subBlocks[i] = 0.0;
+
+	peak.store(0.0f);
+	rms.store(0.0f);
+	loudness.store(silenceLoudness);
+}
+
+void LevelMeter::process(const float* const* channels, int numChannels, int numSamples) noexcept
+{
+	if (numSamples <= 0)
+		return;
+
+	float blockPeak = 0.0f;
+	float blockSquares = 0.0f;
+	double blockEnergy = 0.0;
+	int channelsMetered = 0;
+	for (int channel = 0; channel < jmin(numChannels, maxChannels); channel++)
+	{
+		const float* data = channels[channel];
+		if (data == nullptr)
+			continue;
+		const Range<float> range = FloatVectorOperations::findMinAndMax(data, numSamples);
+		blockPeak = jmax(blockPeak, -range.getStart(), range.getEnd());
+		blockSquares += VectorOps::sumOfSquares(data, numSamples);
+		blockEnergy += kWeightedEnergy(data, numSamples, channel);
+		channelsMetered++;
+	}
+
+	const double blockSeconds = numSamples / sampleRate;
+	peakHold = jmax(blockPeak, peakHold * (float) std::pow(10.0, -blockSeconds));
+	const float blockMeanSquare = channelsMetered > 0 ? blockSquares / (float) (numSamples * channelsMetered) : 0.0f;
+	meanSquare += (blockMeanSquare - meanSquare) * (float) (1.0 - std::exp(-blockSeconds / 0.3));
+
+	// Momentary loudness: mean of the last four 100 ms sub-blocks
+	subBlockEnergy += blockEnergy;
+	subBlockSamples += numSamples;
+	if (subBlockSamples >= subBlockLength)
+	{
+		subBlocks[subBlockIndex] = subBlockEnergy / subBlockSamples;
+		subBlockIndex = (subBlockIndex + 1) & 3;
+		subBlockEnergy = 0.0;
+		subBlockSamples = 0;
+		const double momentary = (subBlocks[0] + subBlocks[1] + subBlocks[2] + subBlocks[3]) * 0.25;
+		loudness.store(momentary > 1.0e-10 ? (float) (-0.691 + 10.0 * std::log10(momentary)) : silenceLoudness,
+			std::memory_order_relaxed);
+	}
+
+	peak.store(peakHold, std::memory_order_relaxed);
+	rms.store(std::sqrt(meanSquare), std::memory_order_relaxed);
+}
+
+float LevelMeter::kWeightedEnergy(const float* data, int numSamples, int channel) noexcept
+{
+	float s1 = state[channel][0], s2 = state[channel][1];
+	float t1 = state[channel][2], t2 = state[channel][3];
+	float energy = 0.0f;
+	for (int i = 0; i < numSamples; i++)
+	{
+		const float x = data[i];
+		const float y = shelf.b0 * x + s1;
+		s1 = shelf.b1 * x - shelf.a1 * y + s2;
+		s2 = shelf.b2 * x - shelf.a2 * y;
+		const float z = highPass.b0 * y + t1;
+		t1 = highPass.b1 * y - highPass.a1 * z + t2;
+		t2 = highPass.b2 * y - highPass.a2 * z;
+		energy += z * z;
+	}
+	state[channel][0] = s1;
+	state[channel][1] = s2;
+	state[channel][2] = t1;
+	state[channel][3] = t2;
+	return energy;
+}
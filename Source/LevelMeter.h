@@ -0,0 +1,54 @@
+//
+//  LevelMeter.h
+//  Light Host
+//
+//  Peak, RMS and momentary loudness (EBU R128, 400 ms) for one point in the
+//  chain. process() runs on the audio thread; the getters may be called from
+//  any thread and only read atomics.
+//
+
+#ifndef LevelMeter_h
+#define LevelMeter_h
+
+#include <atomic>
+
+class LevelMeter
+{
+public:
+	LevelMeter();
+
+	// Not real-time safe; call before the meter sees audio at a new rate
+	void prepare(double sampleRate);
+	void process(const float* const* channels, int numChannels, int numSamples) noexcept;
+
+	// Linear peak with a 20 dB/s fall-off
+	float getPeak() const noexcept      { return peak.load(std::memory_order_relaxed); }
+	// Linear RMS, 300 ms exponential average
+	float getRms() const noexcept       { return rms.load(std::memory_order_relaxed); }
+	// Momentary loudness in LUFS
+	float getLoudness() const noexcept  { return loudness.load(std::memory_order_relaxed); }
+
+	static const int maxChannels = 2;
+
+private:
+	struct Biquad
+	{
+		float b0, b1, b2, a1, a2;
+	};
+
+	float kWeightedEnergy(const float* data, int numSamples, int channel) noexcept;
+
+	Biquad shelf, highPass;
+	float state[maxChannels][4];
+	double sampleRate;
+	float peakHold, meanSquare;
+	double subBlockEnergy;
+	int subBlockSamples, subBlockLength, subBlockIndex;
+	double subBlocks[4];
+
+	std::atomic<float> peak, rms, loudness;
+
+	JUCE_DECLARE_NON_COPYABLE(LevelMeter)
+};
+
+#endif /* LevelMeter_h */
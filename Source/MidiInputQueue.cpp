@@ -0,0 +1,118 @@
+//
+//  MidiInputQueue.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiInputQueue.h"
+
+static const int midiQueueSize = 4096;
+// A short message takes its position, its size and up to three data bytes
+static const int maxEventsPerBlock = MidiInputProcessor::maxBytesPerBlock / (int) (sizeof(int32) + sizeof(uint16) + 3);
+
+MidiInputQueue::MidiInputQueue() : fifo(midiQueueSize), events(midiQueueSize)
+{
+}
+
+MidiInputQueue::~MidiInputQueue()
+{
+}
+
+void MidiInputQueue::handleIncomingMidiMessage(MidiInput*, const MidiMessage& message)
+{
+	// Only short messages are routed; SysEx would need variable sized storage
+	const int size = message.getRawDataSize();
+	if (size < 1 || size > 3)
+		return;
+
+	int start1, size1, start2, size2;
+	fifo.prepareToWrite(1, start1, size1, start2, size2);
+	if (size1 + size2 < 1)
+	{
+		++numDropped;
+		return;
+	}
+	Event& event = events[size1 > 0 ? start1 : start2];
+	event.time = message.getTimeStamp();
+	event.size = (uint8) size;
+	memcpy(event.data, message.getRawData(), (size_t) size);
+	fifo.finishedWrite(1);
+}
+
+void MidiInputQueue::removeNextBlockOfMessages(MidiBuffer& dest, int numSamples, double blockStart, double blockEnd, int maxEvents) noexcept
+{
+	const int numReady = jmin(fifo.getNumReady(), maxEvents);
+	if (numReady == 0 || numSamples <= 0)
+		return;
+
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(numReady, start1, size1, start2, size2);
+	const double scale = blockEnd > blockStart ? numSamples / (blockEnd - blockStart) : 0.0;
+	int numRead = 0;
+	for (int i = 0; i < size1 + size2; i++)
+	{
+		const Event& event = events[i < size1 ? start1 + i : start2 + i - size1];
+		// Events arriving while this block is rendered wait for the next one
+		if (event.time > blockEnd)
+			break;
+		const int position = jlimit(0, numSamples - 1, (int) ((event.time - blockStart) * scale));
+		dest.addEvent(event.data, event.size, position);
+		numRead++;
+	}
+	fifo.finishedRead(numRead);
+}
+
+void MidiInputQueue::discardMessagesBefore(double time) noexcept
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+	int numStale = 0;
+	while (numStale < size1 + size2 && events[numStale < size1 ? start1 + numStale : start2 + numStale - size1].time < time)
+		numStale++;
+	fifo.finishedRead(numStale);
+	numDropped += numStale;
+}
+
+//==============================================================================
+MidiInputProcessor::MidiInputProcessor(MidiInputQueue& q) : queue(q), sampleRate(44100.0), lastBlockEnd(0.0), graphBuffer(nullptr)
+{
+	setPlayConfigDetails(0, 0, sampleRate, 512);
+}
+
+void MidiInputProcessor::prepareToPlay(double newSampleRate, int)
+{
+	sampleRate = newSampleRate;
+	lastBlockEnd = 0.0;
+	spare.ensureSize(MidiInputProcessor::maxBytesPerBlock);
+	graphBuffer = nullptr;
+}
+
+void MidiInputProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	const int numSamples = buffer.getNumSamples();
+	// MIDI timestamps are in seconds on the millisecond counter
+	const double now = Time::getMillisecondCounterHiRes() * 0.001;
+	const double blockLength = numSamples / sampleRate;
+	// The block covers everything since the previous one, which makes the
+	// output a constant one block behind the input, without jitter. After a
+	// stall, fall back to a single block's worth of time.
+	double blockStart = lastBlockEnd;
+	if (blockStart <= 0.0 || now - blockStart > 2.0 * blockLength)
+		blockStart = now - blockLength;
+	// The first block after prepareToPlay would otherwise play everything
+	// that arrived while the device was stopped as one burst at sample 0
+	if (lastBlockEnd <= 0.0)
+		queue.discardMessagesBefore(blockStart);
+	lastBlockEnd = now;
+
+	midiMessages.clear();
+	// The graph keeps handing this node the same buffer, which keeps its
+	// storage across blocks. Swapping the reserved storage in once, and never
+	// adding more than it holds, means nothing here allocates.
+	if (&midiMessages != graphBuffer)
+	{
+		midiMessages.swapWith(spare);
+		graphBuffer = &midiMessages;
+	}
+	queue.removeNextBlockOfMessages(midiMessages, numSamples, blockStart, now, maxEventsPerBlock);
+}
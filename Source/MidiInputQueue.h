@@ -0,0 +1,90 @@
+//
+//  MidiInputQueue.h
+//  Light Host
+//
+//  Collects MIDI from the enabled input devices into a lock-free FIFO and
+//  feeds it into the graph through MidiInputProcessor, which places each
+//  event at its sample position within the block.
+//
+
+#ifndef MidiInputQueue_h
+#define MidiInputQueue_h
+
+class MidiInputQueue : public MidiInputCallback
+{
+public:
+	MidiInputQueue();
+	~MidiInputQueue();
+
+	// Device threads. AudioDeviceManager serialises its MIDI callbacks, so
+	// there is only ever one writer.
+	void handleIncomingMidiMessage(MidiInput* source, const MidiMessage& message) override;
+
+	// Audio thread. Moves up to maxEvents events stamped at or before blockEnd
+	// into dest, spreading them over the block in proportion to their arrival
+	// time. The rest wait for the next block.
+	void removeNextBlockOfMessages(MidiBuffer& dest, int numSamples, double blockStart, double blockEnd, int maxEvents) noexcept;
+	// Audio thread. Throws away events stamped before time, such as those
+	// queued while the device was stopped.
+	void discardMessagesBefore(double time) noexcept;
+
+	// Events lost to a full queue or discarded as stale
+	int getNumDropped() const noexcept { return numDropped.get(); }
+
+private:
+	struct Event
+	{
+		double time;
+		uint8 data[3];
+		uint8 size;
+	};
+
+	AbstractFifo fifo;
+	HeapBlock<Event> events;
+	Atomic<int> numDropped;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiInputQueue)
+};
+
+//==============================================================================
+class MidiInputProcessor : public AudioProcessor
+{
+public:
+	MidiInputProcessor(MidiInputQueue& queue);
+
+	// Most MIDI data the node delivers in one block. Buffers that carry its
+	// output further on reserve at least this much.
+	static const int maxBytesPerBlock = 4096;
+
+	const String getName() const override                   { return "MIDI Input"; }
+	void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override;
+	void releaseResources() override                        {}
+	void processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages) override;
+
+	double getTailLengthSeconds() const override            { return 0.0; }
+	bool acceptsMidi() const override                       { return false; }
+	bool producesMidi() const override                      { return true; }
+
+	AudioProcessorEditor* createEditor() override           { return nullptr; }
+	bool hasEditor() const override                         { return false; }
+
+	int getNumPrograms() override                           { return 1; }
+	int getCurrentProgram() override                        { return 0; }
+	void setCurrentProgram(int) override                    {}
+	const String getProgramName(int) override               { return String(); }
+	void changeProgramName(int, const String&) override     {}
+
+	void getStateInformation(MemoryBlock&) override         {}
+	void setStateInformation(const void*, int) override     {}
+
+private:
+	MidiInputQueue& queue;
+	double sampleRate, lastBlockEnd;
+	// Storage reserved off the audio thread and swapped into the graph's buffer
+	MidiBuffer spare;
+	const MidiBuffer* graphBuffer;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiInputProcessor)
+};
+
+#endif /* MidiInputQueue_h */
@@ -0,0 +1,191 @@
+//
+//  Oversampler.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Oversampler.h"
+#include "VectorOps.h"
+
+// Half the number of non-zero taps in each stage's halfband filter, from the
+// stage next to the device rate upwards. Only the first stage has to keep the
+// passband up to the device Nyquist; the later ones have wide transitions.
+static const int stageHalfLengths[] = { 40, 12, 6 };
+static const int maxPadLength = 8;
+
+class Oversampler::Stage
+{
+public:
+	Stage(int halfLength, int numChannels, int maximumInput)
+		: half(halfLength), taps(2 * halfLength), coefficients(2 * halfLength),
+		buffer(numChannels, 2 * maximumInput),
+		upHistory(numChannels, 2 * halfLength - 1 + maximumInput),
+		evenHistory(numChannels, 2 * halfLength - 1 + maximumInput),
+		oddHistory(numChannels, halfLength + maximumInput)
+	{
+		// Windowed sinc halfband of 4 * half - 1 taps. Every odd tap apart from
+		// the centre is zero, so only the even phase needs storing; it is
+		// symmetric, which lets the dot product run over it unreversed.
+		const int length = 4 * half - 1;
+		const int centre = 2 * half - 1;
+		double sum = 0.0;
+		for (int i = 0; i < taps; i++)
+		{
+			const int j = 2 * i;
+			const double x = (j - centre) * 0.5 * double_Pi;
+			const double phase = 2.0 * double_Pi * j / (length - 1);
+			const double window = 0.35875 - 0.48829 * std::cos(phase) + 0.14128 * std::cos(2.0 * phase) - 0.01168 * std::cos(3.0 * phase);
+			coefficients[i] = (float) (std::sin(x) / x * window);
+			sum += coefficients[i];
+		}
+		// The centre tap is 0.5; the even phase supplies the other half of unity gain
+		for (int i = 0; i < taps; i++)
+			coefficients[i] = (float) (coefficients[i] * 0.5 / sum);
+		reset();
+	}
+
+	void reset() noexcept
+	{
+		buffer.clear();
+		upHistory.clear();
+		evenHistory.clear();
+		oddHistory.clear();
+	}
+
+	// Delay of one filter, in samples at this stage's higher rate
+	int getDelay() const noexcept { return taps - 1; }
+
+	// numSamples in, 2 * numSamples out
+	void upsample(const float* const* input, float* const* output, int numChannels, int numSamples) noexcept
+	{
+		for (int channel = 0; channel < numChannels; channel++)
+		{
+			float* history = upHistory.getWritePointer(channel);
+			float* out = output[channel];
+			memcpy(history + taps - 1, input[channel], sizeof(float) * (size_t) numSamples);
+			for (int i = 0; i < numSamples; i++)
+			{
+				// Zero stuffing halves the level; the factor of two restores it
+				out[2 * i] = 2.0f * VectorOps::dotProduct(coefficients, history + i, taps);
+				out[2 * i + 1] = history[i + half];
+			}
+			memmove(history, history + numSamples, sizeof(float) * (size_t) (taps - 1));
+		}
+	}
+
+	// 2 * numSamples in, numSamples out
+	void downsample(const float* const* input, float* const* output, int numChannels, int numSamples) noexcept
+	{
+		for (int channel = 0; channel < numChannels; channel++)
+		{
+			float* even = evenHistory.getWritePointer(channel);
+			float* odd = oddHistory.getWritePointer(channel);
+			const float* in = input[channel];
+			for (int i = 0; i < numSamples; i++)
+			{
+				even[taps - 1 + i] = in[2 * i];
+				odd[half + i] = in[2 * i + 1];
+			}
+			float* out = output[channel];
+			for (int i = 0; i < numSamples; i++)
+				out[i] = VectorOps::dotProduct(coefficients, even + i, taps) + 0.5f * odd[i];
+			memmove(even, even + numSamples, sizeof(float) * (size_t) (taps - 1));
+			memmove(odd, odd + numSamples, sizeof(float) * (size_t) half);
+		}
+	}
+
+	const int half, taps;
+	HeapBlock<float> coefficients;
+	// Output of upsample, and input of downsample, at the higher rate
+	AudioBuffer<float> buffer;
+
+private:
+	AudioBuffer<float> upHistory, evenHistory, oddHistory;
+
+	JUCE_DECLARE_NON_COPYABLE(Stage)
+};
+
+//==============================================================================
+Oversampler::Oversampler() : factor(1), numChannels(0), maximumBlockSize(0), latency(0), padLength(0), padPosition(0)
+{
+}
+
+Oversampler::~Oversampler()
+{
+}
+
+void Oversampler::prepare(int newNumChannels, int newMaximumBlockSize, int newFactor, int innerLatency)
+{
+	jassert(newFactor == 1 || newFactor == 2 || newFactor == 4 || newFactor == 8);
+	factor = newFactor;
+	numChannels = newNumChannels;
+	maximumBlockSize = jmax(1, newMaximumBlockSize);
+	stages.clear();
+	for (int rate = 2, input = maximumBlockSize; rate <= factor; rate *= 2, input *= 2)
+		stages.add(new Stage(stageHalfLengths[stages.size()], numChannels, input));
+
+	// Each stage filters once on the way up and once on the way down. Counted
+	// at the oversampled rate, the total only becomes a whole number of device
+	// samples after padding, which goes in front of the downsampler.
+	int delay = innerLatency;
+	for (int i = 0; i < stages.size(); i++)
+		delay += 2 * stages[i]->getDelay() * (factor >> (i + 1));
+	padLength = (factor - delay % factor) % factor;
+	latency = (delay + padLength) / factor;
+	padDelay.calloc((size_t) (jmax(1, numChannels) * maxPadLength));
+	padPosition = 0;
+}
+
+void Oversampler::reset() noexcept
+{
+	for (int i = 0; i < stages.size(); i++)
+		stages[i]->reset();
+	padDelay.clear((size_t) (jmax(1, numChannels) * maxPadLength));
+	padPosition = 0;
+}
+
+AudioBuffer<float>& Oversampler::upsample(const AudioBuffer<float>& input, int numSamples) noexcept
+{
+	jassert(stages.size() > 0 && input.getNumChannels() >= numChannels);
+	jassert(numSamples <= maximumBlockSize);
+	const float* const* source = input.getArrayOfReadPointers();
+	for (int i = 0; i < stages.size(); i++)
+	{
+		stages[i]->upsample(source, stages[i]->buffer.getArrayOfWritePointers(), numChannels, numSamples << i);
+		source = stages[i]->buffer.getArrayOfReadPointers();
+	}
+	// Refers to the last stage's storage, so this never allocates
+	view.setDataToReferTo(stages.getLast()->buffer.getArrayOfWritePointers(), numChannels, numSamples * factor);
+	return view;
+}
+
+void Oversampler::downsample(AudioBuffer<float>& output, int numSamples) noexcept
+{
+	applyPadDelay(numSamples * factor);
+	for (int i = stages.size() - 1; i >= 0; i--)
+	{
+		float* const* destination = i > 0 ? stages[i - 1]->buffer.getArrayOfWritePointers() : output.getArrayOfWritePointers();
+		stages[i]->downsample(stages[i]->buffer.getArrayOfReadPointers(), destination, numChannels, numSamples << i);
+	}
+}
+
+void Oversampler::applyPadDelay(int numSamples) noexcept
+{
+	if (padLength == 0)
+		return;
+	int position = padPosition;
+	for (int channel = 0; channel < numChannels; channel++)
+	{
+		float* data = stages.getLast()->buffer.getWritePointer(channel);
+		float* delay = padDelay + channel * maxPadLength;
+		position = padPosition;
+		for (int i = 0; i < numSamples; i++)
+		{
+			const float sample = data[i];
+			data[i] = delay[position];
+			delay[position] = sample;
+			position = (position + 1) % padLength;
+		}
+	}
+	padPosition = position;
+}
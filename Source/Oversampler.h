@@ -0,0 +1,49 @@
+//
+//  Oversampler.h
+//  Light Host
+//
+//  Runs a node at 2x, 4x or 8x the device rate. Each doubling is a halfband
+//  FIR split into its two polyphase branches: one is a pure delay and the
+//  other a short symmetric filter evaluated with VectorOps, so every output
+//  sample costs half the taps of the direct form.
+//
+
+#ifndef Oversampler_h
+#define Oversampler_h
+
+class Oversampler
+{
+public:
+	Oversampler();
+	~Oversampler();
+
+	// Message thread. factor is 1, 2, 4 or 8. innerLatency is the latency of
+	// whatever runs at the oversampled rate, in oversampled samples.
+	void prepare(int numChannels, int maximumBlockSize, int factor, int innerLatency);
+	int getFactor() const noexcept { return factor; }
+	// Longest block, at the device rate, that upsample and downsample take
+	int getMaximumBlockSize() const noexcept { return maximumBlockSize; }
+	// Filter delay plus innerLatency, padded to a whole number of base rate samples
+	int getLatencySamples() const noexcept { return latency; }
+	void reset() noexcept;
+
+	// Audio thread. Returns numSamples * factor samples per channel, valid
+	// until the next call.
+	AudioBuffer<float>& upsample(const AudioBuffer<float>& input, int numSamples) noexcept;
+	// Audio thread. Filters the buffer returned by upsample back into output.
+	void downsample(AudioBuffer<float>& output, int numSamples) noexcept;
+
+private:
+	class Stage;
+
+	void applyPadDelay(int numSamples) noexcept;
+
+	OwnedArray<Stage> stages;
+	AudioBuffer<float> view;
+	HeapBlock<float> padDelay;
+	int factor, numChannels, maximumBlockSize, latency, padLength, padPosition;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Oversampler)
+};
+
+#endif /* Oversampler_h */
@@ -0,0 +1,397 @@
+//
+//  PluginSlot.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PluginSlot.h"
+#include "VectorOps.h"
+#include "AudioThreadMonitor.h"
+#include "MidiInputQueue.h"
+
+static const int parameterQueueSize = 1024;
+// Parameters move in steps of this many samples while morphing
+static const int morphStepSize = 32;
+static const int morphFresh = 4;
+
+static void copyMidi(const MidiBuffer& source, MidiBuffer& destination, int multiply, int divide) noexcept
+{
+	destination.clear();
+	MidiBuffer::Iterator iterator(source);
+	const uint8* data;
+	int size, position;
+	while (iterator.getNextEvent(data, size, position))
+		destination.addEvent(data, size, position * multiply / divide);
+}
+
+PluginSlot::PluginSlot(AudioPluginInstance* p)
+	: plugin(p), nodeName(p->getName()), sanitizeCeiling(4.0f), oversampling(1), numParameters(p->getNumParameters()),
+	parameterFifo(parameterQueueSize), parameterQueue(parameterQueueSize),
+	morphTargets(3 * (numParameters + 1)), morphStart(jmax(1, numParameters)), morphIndices(jmax(1, numParameters)),
+	chunkChannels(jmax(1, p->getTotalNumInputChannels(), p->getTotalNumOutputChannels())),
+	morphMiddle(2), morphBack(1), morphFront(0), numMorphing(0), morphLength(0), morphRemaining(0),
+	budgetFraction(1.0f), peakLoad(0.0f), overrunIndex(0), numOverruns(0)
+{
+	jassert(plugin != nullptr);
+	setPlayConfigDetails(plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels(),
+		plugin->getSampleRate(), plugin->getBlockSize());
+	setLatencySamples(plugin->getLatencySamples());
+}
+
+PluginSlot::~PluginSlot()
+{
+	plugin = nullptr;
+}
+
+void PluginSlot::setSanitizing(bool shouldSanitize, float ceiling)
+{
+	sanitizeCeiling.set(jmax(ceiling, 0.0f));
+	sanitizing.set(shouldSanitize ? 1 : 0);
+}
+
+void PluginSlot::clearFault()
+{
+	faultyBlocks.set(0);
+	peakLoad.set(0.0f);
+	watchdogReset.set(1);
+	faultReason.set(noFault);
+}
+
+void PluginSlot::restoreFault(FaultReason reason, int numFaultyBlocks) noexcept
+{
+	faultyBlocks.set(numFaultyBlocks);
+	faultReason.set(reason);
+}
+
+void PluginSlot::setWatchdog(bool enabled, float newBudgetFraction, int newMaxOverruns, double windowSeconds) noexcept
+{
+	budgetFraction.set(jmax(0.05f, newBudgetFraction));
+	maxOverruns.set(jlimit(1, (int) maxTrackedOverruns, newMaxOverruns));
+	windowTicks.set(Time::secondsToHighResolutionTicks(jmax(0.0, windowSeconds)));
+	watchdogReset.set(1);
+	watchdogEnabled.set(enabled ? 1 : 0);
+}
+
+bool PluginSlot::checkForStall(double stallSeconds) noexcept
+{
+	const int64 since = processingSince.get();
+	if (since == 0 || faultReason.get() != noFault)
+		return false;
+	if (Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - since) < stallSeconds)
+		return false;
+	// The audio thread is still inside the plugin; once it returns, every
+	// following block skips it.
+	faultReason.set(faultStalled);
+	return true;
+}
+
+void PluginSlot::checkBudget(int64 start, int64 elapsed, int numSamples) noexcept
+{
+	if (watchdogReset.compareAndSetBool(0, 1))
+		numOverruns = 0;
+	const double sampleRate = getSampleRate();
+	if (numSamples <= 0 || sampleRate <= 0.0)
+		return;
+
+	const double blockTicks = numSamples / sampleRate * (double) Time::getHighResolutionTicksPerSecond();
+	const float load = (float) (elapsed / blockTicks);
+	if (load > peakLoad.get())
+		peakLoad.set(load);
+	if (load <= budgetFraction.get())
+		return;
+
+	const int64 now = start + elapsed;
+	overrunTimes[overrunIndex] = now;
+	overrunIndex = (overrunIndex + 1) % maxTrackedOverruns;
+	numOverruns = jmin(numOverruns + 1, (int) maxTrackedOverruns);
+
+	// Trip when the oldest of the last maxOverruns overruns is inside the window
+	const int limit = maxOverruns.get();
+	if (numOverruns >= limit
+		&& now - overrunTimes[(overrunIndex - limit + maxTrackedOverruns) % maxTrackedOverruns] <= windowTicks.get())
+		faultReason.set(faultOverBudget);
+}
+
+bool PluginSlot::queueParameterChange(int parameterIndex, float value) noexcept
+{
+	if (parameterIndex < 0 || parameterIndex >= numParameters)
+		return false;
+	int start1, size1, start2, size2;
+	parameterFifo.prepareToWrite(1, start1, size1, start2, size2);
+	if (size1 + size2 < 1)
+		return false;
+	ParameterChange& change = parameterQueue[size1 > 0 ? start1 : start2];
+	change.index = parameterIndex;
+	change.value = jlimit(0.0f, 1.0f, value);
+	parameterFifo.finishedWrite(1);
+	return true;
+}
+
+void PluginSlot::applyParameterChanges() noexcept
+{
+	const int numReady = parameterFifo.getNumReady();
+	if (numReady == 0)
+		return;
+	int start1, size1, start2, size2;
+	parameterFifo.prepareToRead(numReady, start1, size1, start2, size2);
+	for (int i = 0; i < size1; i++)
+		plugin->setParameter(parameterQueue[start1 + i].index, parameterQueue[start1 + i].value);
+	for (int i = 0; i < size2; i++)
+		plugin->setParameter(parameterQueue[start2 + i].index, parameterQueue[start2 + i].value);
+	parameterFifo.finishedRead(size1 + size2);
+}
+
+void PluginSlot::renderPlugin(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	if (oversampler.getFactor() == 1)
+		plugin->processBlock(buffer, midiMessages);
+	else if (buffer.getNumSamples() <= oversampler.getMaximumBlockSize())
+		processOversampled(buffer, midiMessages);
+	else
+		splitOversampled(buffer, midiMessages);
+}
+
+void PluginSlot::processOversampled(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	const int factor = oversampler.getFactor();
+	const int numSamples = buffer.getNumSamples();
+	AudioBuffer<float>& oversampled = oversampler.upsample(buffer, numSamples);
+	// MIDI moves onto the oversampled timeline and back
+	copyMidi(midiMessages, oversampledMidi, factor, 1);
+	plugin->processBlock(oversampled, oversampledMidi);
+	copyMidi(oversampledMidi, midiMessages, 1, factor);
+	oversampler.downsample(buffer, numSamples);
+}
+
+void PluginSlot::splitOversampled(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	// The plugin and the filters only have room for the block size the device
+	// announced, so a longer block is rendered in pieces that fit. The channel
+	// pointers are copied into each piece, so a morph step above can share them.
+	const int maximumBlockSize = oversampler.getMaximumBlockSize();
+	const int numSamples = buffer.getNumSamples();
+	const int numChannels = buffer.getNumChannels();
+	joinedMidi.clear();
+	for (int offset = 0; offset < numSamples; offset += maximumBlockSize)
+	{
+		const int length = jmin(maximumBlockSize, numSamples - offset);
+		for (int channel = 0; channel < numChannels; channel++)
+			chunkChannels[channel] = buffer.getWritePointer(channel) + offset;
+		AudioBuffer<float> piece(chunkChannels, numChannels, length);
+		splitMidi.clear();
+		splitMidi.addEvents(midiMessages, offset, length, -offset);
+		processOversampled(piece, splitMidi);
+		joinedMidi.addEvents(splitMidi, 0, -1, offset);
+	}
+	midiMessages.swapWith(joinedMidi);
+}
+
+void PluginSlot::morphTo(const Array<float>& values, double seconds) noexcept
+{
+	// The last slot of each buffer carries the duration
+	float* target = morphTargets + morphBack * (numParameters + 1);
+	for (int i = 0; i < numParameters; i++)
+		target[i] = i < values.size() ? jlimit(0.0f, 1.0f, values[i]) : -1.0f;
+	target[numParameters] = (float) jmax(0.0, seconds);
+	morphing.set(1);
+	morphBack = morphMiddle.exchange(morphBack | morphFresh) & (morphFresh - 1);
+}
+
+void PluginSlot::applyMorphTarget() noexcept
+{
+	if ((morphMiddle.get() & morphFresh) == 0)
+		return;
+	morphFront = morphMiddle.exchange(morphFront) & (morphFresh - 1);
+	const float* target = morphTargets + morphFront * (numParameters + 1);
+
+	// Start from wherever the parameters are now, including mid-morph
+	numMorphing = 0;
+	for (int i = 0; i < numParameters; i++)
+	{
+		if (target[i] < 0.0f)
+			continue;
+		morphStart[i] = plugin->getParameter(i);
+		if (morphStart[i] != target[i])
+			morphIndices[numMorphing++] = i;
+	}
+	morphLength = jmax(1, roundToInt(target[numParameters] * getSampleRate()));
+	morphRemaining = numMorphing > 0 ? morphLength : 0;
+	if (morphRemaining == 0)
+		morphing.set(0);
+}
+
+void PluginSlot::processMorphing(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	const float* target = morphTargets + morphFront * (numParameters + 1);
+	const int numSamples = buffer.getNumSamples();
+	const int numChannels = buffer.getNumChannels();
+	morphMidi.clear();
+	for (int offset = 0; offset < numSamples; offset += morphStepSize)
+	{
+		const int length = jmin(morphStepSize, numSamples - offset);
+		if (morphRemaining > 0)
+		{
+			// Position at the end of the step, so the last one lands on the target
+			morphRemaining = jmax(0, morphRemaining - length);
+			const float position = 1.0f - morphRemaining / (float) morphLength;
+			const float shaped = position * position * (3.0f - 2.0f * position);
+			for (int i = 0; i < numMorphing; i++)
+			{
+				const int index = morphIndices[i];
+				plugin->setParameter(index, morphStart[index] + (target[index] - morphStart[index]) * shaped);
+			}
+			if (morphRemaining == 0)
+				morphing.set(0);
+		}
+
+		for (int channel = 0; channel < numChannels; channel++)
+			chunkChannels[channel] = buffer.getWritePointer(channel) + offset;
+		AudioBuffer<float> chunk(chunkChannels, numChannels, length);
+		chunkMidi.clear();
+		chunkMidi.addEvents(midiMessages, offset, length, -offset);
+		renderPlugin(chunk, chunkMidi);
+		morphMidi.addEvents(chunkMidi, 0, -1, offset);
+	}
+	midiMessages.swapWith(morphMidi);
+}
+
+String PluginSlot::getFaultDescription(FaultReason reason)
+{
+	switch (reason)
+	{
+		case faultBadOutput:	return "NaN/Inf or runaway output";
+		case faultOverBudget:	return "exceeded the real-time budget";
+		case faultStalled:		return "stalled inside processBlock";
+		default:				return String();
+	}
+}
+
+//==============================================================================
+const String PluginSlot::getName() const
+{
+	return plugin->getName();
+}
+
+void PluginSlot::prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock)
+{
+	const int factor = oversampling == 2 || oversampling == 4 || oversampling == 8 ? oversampling : 1;
+	const int numChannels = jmax(plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels());
+	plugin->setPlayHead(getPlayHead());
+	plugin->setPlayConfigDetails(plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels(),
+		sampleRate * factor, maximumExpectedSamplesPerBlock * factor);
+	plugin->prepareToPlay(sampleRate * factor, maximumExpectedSamplesPerBlock * factor);
+	// The plugin reports latency at its own rate; the oversampler converts it
+	// and adds the filter delay.
+	oversampler.prepare(numChannels, maximumExpectedSamplesPerBlock, factor, plugin->getLatencySamples());
+	// Room for everything the MIDI input node can deliver in a block
+	oversampledMidi.ensureSize(MidiInputProcessor::maxBytesPerBlock);
+	splitMidi.ensureSize(MidiInputProcessor::maxBytesPerBlock);
+	joinedMidi.ensureSize(MidiInputProcessor::maxBytesPerBlock);
+	chunkMidi.ensureSize(MidiInputProcessor::maxBytesPerBlock);
+	morphMidi.ensureSize(MidiInputProcessor::maxBytesPerBlock);
+	setLatencySamples(oversampler.getLatencySamples());
+	meter.prepare(sampleRate);
+}
+
+void PluginSlot::releaseResources()
+{
+	plugin->releaseResources();
+}
+
+void PluginSlot::reset()
+{
+	plugin->reset();
+	oversampler.reset();
+}
+
+void PluginSlot::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	applyParameterChanges();
+	applyMorphTarget();
+	// A faulted plugin is skipped; the input passes straight through
+	if (faultReason.get() == noFault)
+	{
+		if (watchdogEnabled.get() != 0)
+		{
+			const int64 start = Time::getHighResolutionTicks();
+			processingSince.set(start);
+			processPlugin(buffer, midiMessages);
+			processingSince.set(0);
+			checkBudget(start, Time::getHighResolutionTicks() - start, buffer.getNumSamples());
+		}
+		else
+			processPlugin(buffer, midiMessages);
+	}
+	else if (morphRemaining > 0)
+	{
+		// processMorphing never runs for a skipped plugin, so the glide is
+		// abandoned here rather than shown as running forever
+		morphRemaining = 0;
+		morphing.set(0);
+	}
+	meter.process(buffer.getArrayOfReadPointers(), buffer.getNumChannels(), buffer.getNumSamples());
+}
+
+void PluginSlot::processPlugin(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+	// Same contract the graph applies to every node it renders
+	if (plugin->isSuspended())
+	{
+		buffer.clear();
+		return;
+	}
+	{
+		const ScopedLock sl(plugin->getCallbackLock());
+		const AudioThreadMonitor::ScopedNode node(nodeName.toRawUTF8());
+		if (morphRemaining > 0)
+			processMorphing(buffer, midiMessages);
+		else
+			renderPlugin(buffer, midiMessages);
+	}
+
+	if (sanitizing.get() != 0)
+	{
+		int bad = 0;
+		const int numChannels = jmin(buffer.getNumChannels(), plugin->getTotalNumOutputChannels());
+		for (int channel = 0; channel < numChannels; channel++)
+			bad += VectorOps::sanitize(buffer.getWritePointer(channel), buffer.getNumSamples(), sanitizeCeiling.get());
+		if (bad > 0)
+		{
+			++faultyBlocks;
+			if (autoBypass.get() != 0)
+				faultReason.set(faultBadOutput);
+		}
+	}
+}
+
+void PluginSlot::setNonRealtime(bool isNonRealtime) noexcept
+{
+	AudioProcessor::setNonRealtime(isNonRealtime);
+	plugin->setNonRealtime(isNonRealtime);
+}
+
+double PluginSlot::getTailLengthSeconds() const		{ return plugin->getTailLengthSeconds(); }
+bool PluginSlot::acceptsMidi() const				{ return plugin->acceptsMidi(); }
+bool PluginSlot::producesMidi() const				{ return plugin->producesMidi(); }
+
+int PluginSlot::getNumPrograms()										{ return plugin->getNumPrograms(); }
+int PluginSlot::getCurrentProgram()										{ return plugin->getCurrentProgram(); }
+void PluginSlot::setCurrentProgram(int index)							{ plugin->setCurrentProgram(index); }
+const String PluginSlot::getProgramName(int index)						{ return plugin->getProgramName(index); }
+void PluginSlot::changeProgramName(int index, const String& newName)	{ plugin->changeProgramName(index, newName); }
+
+int PluginSlot::getNumParameters()										{ return plugin->getNumParameters(); }
+float PluginSlot::getParameter(int parameterIndex)						{ return plugin->getParameter(parameterIndex); }
+void PluginSlot::setParameter(int parameterIndex, float newValue)		{ plugin->setParameter(parameterIndex, newValue); }
+const String PluginSlot::getParameterName(int parameterIndex)			{ return plugin->getParameterName(parameterIndex); }
+const String PluginSlot::getParameterText(int parameterIndex)			{ return plugin->getParameterText(parameterIndex); }
+
+void PluginSlot::getStateInformation(MemoryBlock& destData)
+{
+	plugin->getStateInformation(destData);
+}
+
+void PluginSlot::setStateInformation(const void* data, int sizeInBytes)
+{
+	plugin->setStateInformation(data, sizeInBytes);
+}
@@ -0,0 +1,156 @@
+//
+//  PluginSlot.h
+//  Light Host
+//
+//  Wraps each hosted plugin inside the graph so the host can guard what the
+//  plugin does on the audio thread without touching the plugin itself.
+//
+
+#ifndef PluginSlot_h
+#define PluginSlot_h
+
+#include "LevelMeter.h"
+#include "Oversampler.h"
+
+class PluginSlot : public AudioProcessor
+{
+public:
+	enum FaultReason
+	{
+		noFault = 0,
+		faultBadOutput,
+		faultOverBudget,
+		faultStalled
+	};
+
+	// Takes ownership of the plugin instance
+	PluginSlot(AudioPluginInstance* plugin);
+	~PluginSlot();
+
+	AudioPluginInstance* getPlugin() const noexcept { return plugin; }
+
+	// Output sanitization (NaN/Inf removal and level clamping)
+	void setSanitizing(bool shouldSanitize, float ceiling);
+	bool isSanitizing() const noexcept { return sanitizing.get() != 0; }
+	// Bypass the plugin as soon as it produces bad output
+	void setAutoBypass(bool shouldAutoBypass) noexcept { autoBypass.set(shouldAutoBypass ? 1 : 0); }
+
+	int getNumFaultyBlocks() const noexcept { return faultyBlocks.get(); }
+	FaultReason getFaultReason() const noexcept { return (FaultReason) faultReason.get(); }
+	bool isFaultBypassed() const noexcept { return getFaultReason() != noFault; }
+	bool hasFault() const noexcept { return isFaultBypassed() || getNumFaultyBlocks() > 0; }
+	void clearFault();
+	// Message thread, before the slot is added to the graph. Carries the
+	// fault over from the slot this one replaces.
+	void restoreFault(FaultReason reason, int numFaultyBlocks) noexcept;
+	static String getFaultDescription(FaultReason reason);
+
+	// Watchdog: bypass the plugin once processBlock takes longer than
+	// budgetFraction of the block period maxOverruns times within windowSeconds
+	void setWatchdog(bool enabled, float budgetFraction, int maxOverruns, double windowSeconds) noexcept;
+	// Polled from the watchdog thread. Flags a plugin that has been inside
+	// processBlock for longer than stallSeconds so it is bypassed from the
+	// next block on. A plugin that never returns keeps the audio thread.
+	bool checkForStall(double stallSeconds) noexcept;
+	// Longest processBlock seen, as a fraction of the block period
+	float getPeakLoad() const noexcept { return peakLoad.get(); }
+
+	// Parameter changes from outside the audio thread, applied at the start of
+	// the next block. Callers must make sure only one thread pushes at a time.
+	bool queueParameterChange(int parameterIndex, float value) noexcept;
+
+	// Levels at the slot's output
+	const LevelMeter& getMeter() const noexcept { return meter; }
+
+	// Glides every parameter from its current value to values over seconds.
+	// The audio thread picks the target up at the next block and updates the
+	// parameters every few samples along an S-curve. Message thread only.
+	void morphTo(const Array<float>& values, double seconds) noexcept;
+	bool isMorphing() const noexcept { return morphing.get() != 0; }
+
+	// Runs the plugin at factor (1, 2, 4 or 8) times the graph's rate. Takes
+	// effect the next time the graph prepares the slot.
+	void setOversampling(int factor) noexcept { oversampling = factor; }
+	int getOversampling() const noexcept { return oversampling; }
+
+	//==============================================================================
+	const String getName() const override;
+	void prepareToPlay(double sampleRate, int maximumExpectedSamplesPerBlock) override;
+	void releaseResources() override;
+	void reset() override;
+	void processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages) override;
+	void setNonRealtime(bool isNonRealtime) noexcept override;
+
+	double getTailLengthSeconds() const override;
+	bool acceptsMidi() const override;
+	bool producesMidi() const override;
+
+	AudioProcessorEditor* createEditor() override                  { return nullptr; }
+	bool hasEditor() const override                                { return false; }
+
+	int getNumPrograms() override;
+	int getCurrentProgram() override;
+	void setCurrentProgram(int index) override;
+	const String getProgramName(int index) override;
+	void changeProgramName(int index, const String& newName) override;
+
+	int getNumParameters() override;
+	float getParameter(int parameterIndex) override;
+	void setParameter(int parameterIndex, float newValue) override;
+	const String getParameterName(int parameterIndex) override;
+	const String getParameterText(int parameterIndex) override;
+
+	void getStateInformation(MemoryBlock& destData) override;
+	void setStateInformation(const void* data, int sizeInBytes) override;
+
+private:
+	struct ParameterChange
+	{
+		int index;
+		float value;
+	};
+
+	void applyParameterChanges() noexcept;
+	void checkBudget(int64 start, int64 elapsed, int numSamples) noexcept;
+	void processPlugin(AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+	void processOversampled(AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+	void splitOversampled(AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+	void renderPlugin(AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+	void applyMorphTarget() noexcept;
+	void processMorphing(AudioBuffer<float>& buffer, MidiBuffer& midiMessages);
+
+	ScopedPointer<AudioPluginInstance> plugin;
+	// Kept as UTF-8 so the audio thread can hand it out without converting
+	const String nodeName;
+	Atomic<int> sanitizing, autoBypass, faultyBlocks, faultReason;
+	Atomic<float> sanitizeCeiling;
+	LevelMeter meter;
+	int oversampling;
+	Oversampler oversampler;
+	MidiBuffer oversampledMidi, splitMidi, joinedMidi;
+	// Sizes the parameter blocks below, so it has to be initialised first
+	const int numParameters;
+	AbstractFifo parameterFifo;
+	HeapBlock<ParameterChange> parameterQueue;
+
+	// Morph targets are handed over in a triple buffer: the message thread
+	// fills morphBack and swaps it into the middle, the audio thread swaps the
+	// middle out for morphFront whenever it is marked fresh.
+	HeapBlock<float> morphTargets, morphStart;
+	HeapBlock<int> morphIndices;
+	HeapBlock<float*> chunkChannels;
+	Atomic<int> morphMiddle, morphing;
+	int morphBack, morphFront, numMorphing, morphLength, morphRemaining;
+	MidiBuffer chunkMidi, morphMidi;
+
+	static const int maxTrackedOverruns = 32;
+	Atomic<int> watchdogEnabled, maxOverruns, watchdogReset;
+	Atomic<float> budgetFraction, peakLoad;
+	Atomic<int64> windowTicks, processingSince;
+	int64 overrunTimes[maxTrackedOverruns];
+	int overrunIndex, numOverruns;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginSlot)
+};
+
+#endif /* PluginSlot_h */
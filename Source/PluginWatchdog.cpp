@@ -0,0 +1,41 @@
+//
+//  PluginWatchdog.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PluginWatchdog.h"
+#include "PluginSlot.h"
+
+PluginWatchdog::PluginWatchdog(CriticalSection& lock, const Array<PluginSlot*>& s)
+	: Thread("Plugin Watchdog"), slotLock(lock), slots(s), stallSeconds(1.0)
+{
+}
+
+PluginWatchdog::~PluginWatchdog()
+{
+	stop();
+}
+
+void PluginWatchdog::start(double newStallSeconds)
+{
+	stop();
+	stallSeconds = jmax(0.05, newStallSeconds);
+	startThread();
+}
+
+void PluginWatchdog::stop()
+{
+	stopThread(2000);
+}
+
+void PluginWatchdog::run()
+{
+	while (!threadShouldExit())
+	{
+		wait(50);
+		const ScopedLock sl(slotLock);
+		for (int i = 0; i < slots.size(); i++)
+			slots[i]->checkForStall(stallSeconds);
+	}
+}
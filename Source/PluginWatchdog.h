@@ -0,0 +1,37 @@
+//
+//  PluginWatchdog.h
+//  Light Host
+//
+//  Polls the plugin slots from its own thread and flags any plugin that has
+//  stalled inside processBlock for too long, so it is bypassed once it
+//  returns. Budget overruns are caught by the slots themselves, but only
+//  after the block ends; this catches a long stall while it is happening.
+//  A plugin that never returns cannot be recovered from here.
+//
+
+#ifndef PluginWatchdog_h
+#define PluginWatchdog_h
+
+class PluginSlot;
+
+class PluginWatchdog : private Thread
+{
+public:
+	PluginWatchdog(CriticalSection& slotLock, const Array<PluginSlot*>& slots);
+	~PluginWatchdog();
+
+	void start(double stallSeconds);
+	void stop();
+	bool isRunning() const { return isThreadRunning(); }
+
+private:
+	void run() override;
+
+	CriticalSection& slotLock;
+	const Array<PluginSlot*>& slots;
+	double stallSeconds;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginWatchdog)
+};
+
+#endif /* PluginWatchdog_h */
@@ -1,5 +1,6 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginWindow.h"
+#include "PluginSlot.h"
 
 class PluginWindow;
 static Array <PluginWindow*> activePluginWindows;
@@ -144,6 +145,10 @@ PluginWindow* PluginWindow::getWindowFor (AudioProcessorGraph::Node* const node,
     AudioProcessor* processor = node->getProcessor();
     AudioProcessorEditor* ui = nullptr;
 
+    // Editors belong to the hosted plugin, not the slot wrapping it
+    if (PluginSlot* const slot = dynamic_cast<PluginSlot*> (processor))
+        processor = slot->getPlugin();
+
     if (type == Normal)
     {
         ui = processor->createEditorIfNeeded();
@@ -0,0 +1,127 @@
+//
+//  RealtimeSupport.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "RealtimeSupport.h"
+#include <cerrno>
+#include <cstring>
+#if JUCE_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+RealtimeSupport::RealtimeSupport() : memoryLocked(false)
+{
+}
+
+RealtimeSupport::~RealtimeSupport()
+{
+	unlockMemory();
+}
+
+void RealtimeSupport::configure(bool shouldEnable, int newPriority, const String& cpus)
+{
+	int64 mask = 0;
+	StringArray cores;
+	cores.addTokens(cpus, ",", String());
+	cores.trim();
+	cores.removeEmptyStrings();
+	for (int i = 0; i < cores.size(); i++)
+	{
+		const int core = cores[i].getIntValue();
+		if (core >= 0 && core < 64)
+			mask |= ((int64) 1) << core;
+	}
+
+	priority.set(jlimit(1, 99, newPriority));
+	cpuMask.set(mask);
+	enabled.set(shouldEnable ? 1 : 0);
+	appliedToThread.set(0);
+
+	#if JUCE_LINUX
+	setResult(schedulingStep, shouldEnable ? pending : notRequested);
+	setResult(affinityStep, shouldEnable && mask != 0 ? pending : notRequested);
+	setResult(memoryLockStep, shouldEnable ? pending : notRequested);
+	setResult(prefaultStep, shouldEnable ? pending : notRequested);
+	#else
+	for (int step = 0; step < numSteps; step++)
+		setResult((Step) step, shouldEnable ? unsupported : notRequested);
+	#endif
+}
+
+void RealtimeSupport::lockMemory()
+{
+	#if JUCE_LINUX
+	if (memoryLocked)
+		return;
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+	{
+		memoryLocked = true;
+		setResult(memoryLockStep, succeeded);
+	}
+	else
+		setResult(memoryLockStep, failed, errno);
+	#endif
+}
+
+void RealtimeSupport::unlockMemory()
+{
+	#if JUCE_LINUX
+	if (memoryLocked)
+		munlockall();
+	#endif
+	memoryLocked = false;
+}
+
+void RealtimeSupport::applyToCurrentThread() noexcept
+{
+	if (enabled.get() == 0 || appliedToThread.get() != 0)
+		return;
+	appliedToThread.set(1);
+
+	#if JUCE_LINUX
+	sched_param param;
+	zerostruct(param);
+	param.sched_priority = priority.get();
+	const int schedulingError = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	setResult(schedulingStep, schedulingError == 0 ? succeeded : failed, schedulingError);
+
+	const int64 mask = cpuMask.get();
+	if (mask != 0)
+	{
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		for (int core = 0; core < 64; core++)
+			if ((mask & (((int64) 1) << core)) != 0)
+				CPU_SET(core, &cpus);
+		const int affinityError = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		setResult(affinityStep, affinityError == 0 ? succeeded : failed, affinityError);
+	}
+	#endif
+}
+
+void RealtimeSupport::setResult(Step step, Status newStatus, int newError) noexcept
+{
+	error[step].set(newError);
+	status[step].set(newStatus);
+}
+
+String RealtimeSupport::getDescription(Step step) const
+{
+	static const char* const names[numSteps] = { "SCHED_FIFO", "CPU pinning", "Memory lock", "Buffer pre-fault" };
+	String name = names[step];
+	if (step == schedulingStep)
+		name << " " << priority.get();
+
+	switch (getStatus(step))
+	{
+		case pending:		return name + ": pending";
+		case succeeded:		return name + ": ok";
+		case failed:		return name + ": failed (" + String(strerror(error[step].get())) + ")";
+		case unsupported:	return name + ": not supported on this platform";
+		default:			return name + ": off";
+	}
+}
@@ -0,0 +1,65 @@
+//
+//  RealtimeSupport.h
+//  Light Host
+//
+//  Low latency mode for Linux: SCHED_FIFO and CPU pinning for the audio
+//  thread, mlockall for plugin code and data, and a silent warm-up block
+//  that faults in the graph's buffers before the device starts streaming.
+//  Each step records whether it worked so the menu can report it.
+//
+
+#ifndef RealtimeSupport_h
+#define RealtimeSupport_h
+
+class RealtimeSupport
+{
+public:
+	enum Step
+	{
+		schedulingStep = 0,
+		affinityStep,
+		memoryLockStep,
+		prefaultStep,
+		numSteps
+	};
+
+	enum Status
+	{
+		notRequested = 0,
+		pending,
+		succeeded,
+		failed,
+		unsupported
+	};
+
+	RealtimeSupport();
+	~RealtimeSupport();
+
+	// Message thread. cpus is a comma separated list of core numbers; empty
+	// leaves the affinity alone.
+	void configure(bool enabled, int priority, const String& cpus);
+	bool isEnabled() const noexcept { return enabled.get() != 0; }
+
+	// Message thread. Locks every current and future page of the process.
+	void lockMemory();
+	void unlockMemory();
+
+	// Audio thread. Applies priority and affinity once per device thread.
+	void applyToCurrentThread() noexcept;
+	// The next callback may run on a new thread; apply again there
+	void threadChanged() noexcept { appliedToThread.set(0); }
+
+	void setResult(Step step, Status status, int error = 0) noexcept;
+	Status getStatus(Step step) const noexcept { return (Status) status[step].get(); }
+	String getDescription(Step step) const;
+
+private:
+	Atomic<int> enabled, appliedToThread, priority;
+	Atomic<int64> cpuMask;
+	Atomic<int> status[numSteps], error[numSteps];
+	bool memoryLocked;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RealtimeSupport)
+};
+
+#endif /* RealtimeSupport_h */
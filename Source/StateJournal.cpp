@@ -0,0 +1,262 @@
+//
+//  StateJournal.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "StateJournal.h"
+
+static const int journalMagic = 0x314a484c; // "LHJ1"
+// Record header: magic, type, key size, data size
+static const int headerSize = 13;
+static const int64 minimumCompactSize = 1024 * 1024;
+
+static void setState(StringArray& keys, OwnedArray<MemoryBlock>& states, const String& key, const MemoryBlock& state)
+{
+	const int index = keys.indexOf(key);
+	if (index >= 0)
+		*states[index] = state;
+	else
+	{
+		keys.add(key);
+		states.add(new MemoryBlock(state));
+	}
+}
+
+StateJournal::StateJournal(Source& s) : Thread("State Journal"), source(s)
+{
+}
+
+StateJournal::~StateJournal()
+{
+	close();
+}
+
+void StateJournal::open(const File& file, double intervalSeconds)
+{
+	close();
+	journalFile = file;
+	recover();
+
+	// The writer starts by compacting these into a fresh journal, which also
+	// drops any torn record left by a crash.
+	latestKeys = recoveredKeys;
+	latestStates.clear();
+	lastHashes.clear();
+	for (int i = 0; i < recoveredKeys.size(); i++)
+	{
+		latestStates.add(new MemoryBlock(*recoveredStates[i]));
+		lastHashes.set(recoveredKeys[i], hash(stateRecord, recoveredKeys[i], *recoveredStates[i]));
+	}
+	startThread(3);
+	if (intervalSeconds > 0.0)
+		startTimer(roundToInt(intervalSeconds * 1000.0));
+}
+
+void StateJournal::close()
+{
+	stopTimer();
+	signalThreadShouldExit();
+	notify();
+	stopThread(5000);
+	stream = nullptr;
+}
+
+bool StateJournal::getRecoveredState(const String& key, MemoryBlock& state) const
+{
+	const int index = recoveredKeys.indexOf(key);
+	if (index < 0)
+		return false;
+	state = *recoveredStates[index];
+	return true;
+}
+
+void StateJournal::checkpoint()
+{
+	recoveredKeys.clear();
+	recoveredStates.clear();
+	const ScopedLock sl(writeLock);
+	{
+		// Everything still queued is older than the settings just written
+		const ScopedLock ql(queueLock);
+		queue.clear();
+	}
+	latestKeys.clear();
+	latestStates.clear();
+	compact();
+	// If the empty journal could not be written, no journal is still safe
+	if (stream == nullptr)
+		journalFile.deleteFile();
+}
+
+void StateJournal::timerCallback()
+{
+	StringArray keys;
+	OwnedArray<MemoryBlock> states;
+	source.getJournalStates(keys, states);
+
+	OwnedArray<Record> snapshot;
+	for (int i = 0; i < keys.size() && i < states.size(); i++)
+	{
+		const int64 stateHash = hash(stateRecord, keys[i], *states[i]);
+		if (lastHashes.contains(keys[i]) && lastHashes[keys[i]] == stateHash)
+			continue;
+		lastHashes.set(keys[i], stateHash);
+		Record* record = snapshot.add(new Record());
+		record->type = stateRecord;
+		record->key = keys[i];
+		record->data.swapWith(*states[i]);
+	}
+	if (snapshot.size() == 0)
+		return;
+
+	Record* commit = snapshot.add(new Record());
+	commit->type = commitRecord;
+	{
+		const ScopedLock sl(queueLock);
+		while (snapshot.size() > 0)
+			queue.add(snapshot.removeAndReturn(0));
+	}
+	notify();
+}
+
+void StateJournal::run()
+{
+	{
+		const ScopedLock sl(writeLock);
+		compact();
+	}
+	for (;;)
+	{
+		// Drains once more after close() so the last snapshot is not lost
+		const bool exiting = threadShouldExit();
+		{
+			const ScopedLock sl(writeLock);
+			OwnedArray<Record> records;
+			{
+				const ScopedLock ql(queueLock);
+				records.swapWith(queue);
+			}
+			if (records.size() > 0)
+				writeRecords(records);
+		}
+		if (exiting)
+			break;
+		wait(1000);
+	}
+}
+
+void StateJournal::recover()
+{
+	recoveredKeys.clear();
+	recoveredStates.clear();
+	FileInputStream in(journalFile);
+	if (in.failedToOpen())
+		return;
+
+	// States only count once the commit record that closes their snapshot is
+	// intact; anything after the last good record is a torn write.
+	StringArray pendingKeys;
+	OwnedArray<MemoryBlock> pendingStates;
+	while (in.getNumBytesRemaining() >= headerSize + 8)
+	{
+		if (in.readInt() != journalMagic)
+			break;
+		const RecordType type = (RecordType) in.readByte();
+		const int keySize = in.readInt();
+		const int dataSize = in.readInt();
+		if (keySize < 0 || dataSize < 0 || in.getNumBytesRemaining() < (int64) keySize + dataSize + 8)
+			break;
+		MemoryBlock keyData, data;
+		in.readIntoMemoryBlock(keyData, keySize);
+		in.readIntoMemoryBlock(data, dataSize);
+		const String key = String::fromUTF8((const char*) keyData.getData(), keySize);
+		if (in.readInt64() != hash(type, key, data))
+			break;
+
+		if (type == stateRecord)
+			setState(pendingKeys, pendingStates, key, data);
+		else if (type == commitRecord)
+		{
+			for (int i = 0; i < pendingKeys.size(); i++)
+				setState(recoveredKeys, recoveredStates, pendingKeys[i], *pendingStates[i]);
+			pendingKeys.clear();
+			pendingStates.clear();
+		}
+		else
+			break;
+	}
+}
+
+void StateJournal::writeRecords(const OwnedArray<Record>& records)
+{
+	for (int i = 0; i < records.size(); i++)
+	{
+		const Record& record = *records[i];
+		if (record.type == stateRecord)
+			setState(latestKeys, latestStates, record.key, record.data);
+		if (stream != nullptr)
+		{
+			writeRecord(*stream, record.type, record.key, record.data);
+			if (record.type == commitRecord)
+				stream->flush();
+		}
+	}
+
+	int64 liveSize = 0;
+	for (int i = 0; i < latestStates.size(); i++)
+		liveSize += (int64) latestStates[i]->getSize();
+	// A failed open is retried here too; compacting writes everything out
+	if (stream == nullptr || stream->getPosition() > jmax(minimumCompactSize, 4 * liveSize))
+		compact();
+}
+
+void StateJournal::compact()
+{
+	stream = nullptr;
+	// Written beside the journal and renamed over it, so a crash leaves
+	// either the old journal or the new one
+	const File temp(journalFile.getSiblingFile(journalFile.getFileName() + ".tmp"));
+	temp.deleteFile();
+	{
+		FileOutputStream out(temp);
+		if (out.failedToOpen())
+			return;
+		for (int i = 0; i < latestKeys.size(); i++)
+			writeRecord(out, stateRecord, latestKeys[i], *latestStates[i]);
+		if (latestKeys.size() > 0)
+			writeRecord(out, commitRecord, String(), MemoryBlock());
+		out.flush();
+	}
+	if (!temp.replaceFileIn(journalFile))
+		return;
+	stream = new FileOutputStream(journalFile);
+	if (stream->failedToOpen())
+		stream = nullptr;
+}
+
+void StateJournal::writeRecord(OutputStream& out, RecordType type, const String& key, const MemoryBlock& data)
+{
+	const int keySize = (int) key.getNumBytesAsUTF8();
+	out.writeInt(journalMagic);
+	out.writeByte((char) type);
+	out.writeInt(keySize);
+	out.writeInt((int) data.getSize());
+	out.write(key.toRawUTF8(), (size_t) keySize);
+	out.write(data.getData(), data.getSize());
+	out.writeInt64(hash(type, key, data));
+}
+
+int64 StateJournal::hash(RecordType type, const String& key, const MemoryBlock& data) noexcept
+{
+	// FNV-1a over the type, the key and the state
+	uint64 value = 14695981039346656037ULL;
+	value = (value ^ (uint8) type) * 1099511628211ULL;
+	const uint8* keyBytes = (const uint8*) key.toRawUTF8();
+	for (size_t i = 0, size = key.getNumBytesAsUTF8(); i < size; i++)
+		value = (value ^ keyBytes[i]) * 1099511628211ULL;
+	const uint8* dataBytes = (const uint8*) data.getData();
+	for (size_t i = 0; i < data.getSize(); i++)
+		value = (value ^ dataBytes[i]) * 1099511628211ULL;
+	return (int64) value;
+}
@@ -0,0 +1,88 @@
+//
+//  StateJournal.h
+//  Light Host
+//
+//  Crash-safe autosave of plugin states. A timer on the message thread
+//  collects every plugin's state, hashes it, and queues the ones that
+//  changed as one snapshot. A background thread appends each snapshot to a
+//  journal next to the settings file, followed by a commit record. Every
+//  record carries a checksum, so a torn write at the end is simply ignored
+//  on recovery. The journal is compacted to one record per plugin once it
+//  grows, and truncated whenever the settings file has the states again.
+//
+
+#ifndef StateJournal_h
+#define StateJournal_h
+
+class StateJournal : private Thread, private Timer
+{
+public:
+	class Source
+	{
+	public:
+		virtual ~Source() {}
+		// Called on the message thread; fills in each plugin's key and current state
+		virtual void getJournalStates(StringArray& keys, OwnedArray<MemoryBlock>& states) = 0;
+	};
+
+	StateJournal(Source& source);
+	~StateJournal();
+
+	// Message thread. Recovers the last complete snapshot from file, then
+	// snapshots every intervalSeconds; 0 only recovers.
+	void open(const File& file, double intervalSeconds);
+	void close();
+
+	// A recovered state is newer than the one in the settings file
+	bool getRecoveredState(const String& key, MemoryBlock& state) const;
+	int getNumRecovered() const { return recoveredKeys.size(); }
+
+	// Message thread. Call after the settings file has been written with
+	// every plugin state. Empties the journal before returning, so older
+	// snapshots can never be replayed over the settings.
+	void checkpoint();
+
+private:
+	enum RecordType
+	{
+		stateRecord = 1,
+		commitRecord
+	};
+
+	struct Record
+	{
+		RecordType type;
+		String key;
+		MemoryBlock data;
+	};
+
+	void timerCallback() override;
+	void run() override;
+	void recover();
+	void writeRecords(const OwnedArray<Record>& records);
+	void compact();
+	static void writeRecord(OutputStream& out, RecordType type, const String& key, const MemoryBlock& data);
+	static int64 hash(RecordType type, const String& key, const MemoryBlock& data) noexcept;
+
+	Source& source;
+	File journalFile;
+	HashMap<String, int64> lastHashes;
+	StringArray recoveredKeys;
+	OwnedArray<MemoryBlock> recoveredStates;
+
+	// Shared with the writer thread
+	CriticalSection queueLock;
+	OwnedArray<Record> queue;
+
+	// Held while records leave the queue until they are on disk, so a
+	// checkpoint never lands between the two. Guards everything below.
+	CriticalSection writeLock;
+	// The newest committed state for each key
+	StringArray latestKeys;
+	OwnedArray<MemoryBlock> latestStates;
+	ScopedPointer<FileOutputStream> stream;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StateJournal)
+};
+
+#endif /* StateJournal_h */
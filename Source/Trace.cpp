@@ -0,0 +1,113 @@
+//
+//  Trace.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Trace.h"
+
+static const uint32 traceBufferSize = 16384;
+static const int maxDetail = 64;
+
+struct TraceEvent
+{
+	// index + 1 of the write that completed this slot, 0 while one is in progress
+	std::atomic<uint32> sequence;
+	const char* name;
+	char detail[maxDetail];
+	int64 start, end;
+	pointer_sized_int thread;
+};
+
+std::atomic<int> Trace::enabled(0);
+static std::atomic<uint32> nextEvent(0);
+static std::atomic<int64> origin(0);
+static TraceEvent events[traceBufferSize];
+
+void Trace::setEnabled(bool shouldEnable) noexcept
+{
+	// Each recording starts from an empty ring, so an export never mixes runs
+	if (shouldEnable && !isEnabled())
+	{
+		clear();
+		origin.store(Time::getHighResolutionTicks());
+	}
+	enabled.store(shouldEnable ? 1 : 0);
+}
+
+void Trace::clear() noexcept
+{
+	for (uint32 i = 0; i < traceBufferSize; i++)
+		events[i].sequence.store(0);
+}
+
+Trace::Scope::Scope(const char* n) noexcept
+	: name(n), start(isEnabled() ? Time::getHighResolutionTicks() : 0)
+{
+}
+
+Trace::Scope::Scope(const char* n, const String& d) noexcept
+	: name(n), start(isEnabled() ? Time::getHighResolutionTicks() : 0)
+{
+	if (start != 0)
+		detail = d;
+}
+
+Trace::Scope::~Scope() noexcept
+{
+	if (start != 0)
+		record(name, detail, start, Time::getHighResolutionTicks());
+}
+
+void Trace::record(const char* name, const String& detail, int64 start, int64 end) noexcept
+{
+	const uint32 index = nextEvent.fetch_add(1);
+	TraceEvent& event = events[index % traceBufferSize];
+	event.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	event.name = name;
+	detail.copyToUTF8(event.detail, maxDetail);
+	event.start = start;
+	event.end = end;
+	event.thread = (pointer_sized_int) Thread::getCurrentThreadId();
+	event.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool Trace::exportJson(const File& file)
+{
+	const uint32 end = nextEvent.load();
+	const uint32 first = end > traceBufferSize ? end - traceBufferSize : 0;
+	const double ticksToMicroseconds = 1.0e6 / (double) Time::getHighResolutionTicksPerSecond();
+	Array<pointer_sized_int> threads;
+
+	String json;
+	json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool firstEvent = true;
+	for (uint32 i = first; i != end; i++)
+	{
+		TraceEvent& slot = events[i % traceBufferSize];
+		if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+			continue;
+		const char* name = slot.name;
+		const String detail = String::fromUTF8(slot.detail);
+		const int64 start = slot.start, finish = slot.end;
+		const pointer_sized_int thread = slot.thread;
+		// Overwritten while being read
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != i + 1)
+			continue;
+
+		threads.addIfNotAlreadyThere(thread);
+		json << (firstEvent ? "" : ",") << newLine
+			<< "{\"name\":" << JSON::toString(var(String(name)))
+			<< ",\"cat\":\"host\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (threads.indexOf(thread) + 1)
+			<< ",\"ts\":" << String((start - origin.load()) * ticksToMicroseconds, 1)
+			<< ",\"dur\":" << String((finish - start) * ticksToMicroseconds, 1);
+		if (detail.isNotEmpty())
+			json << ",\"args\":{\"detail\":" << JSON::toString(var(detail)) << "}";
+		json << "}";
+		firstEvent = false;
+	}
+	json << newLine << "]}" << newLine;
+	return file.replaceWithText(json);
+}
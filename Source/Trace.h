@@ -0,0 +1,54 @@
+//
+//  Trace.h
+//  Light Host
+//
+//  Scoped timing of message thread operations, for profiling startup and
+//  chain edits in the field. Finished scopes are written into a fixed ring
+//  without locking and can be exported as Chrome trace-event JSON, which
+//  chrome://tracing and Perfetto load directly. While tracing is off a
+//  scope costs a single relaxed load.
+//
+
+#ifndef Trace_h
+#define Trace_h
+
+#include <atomic>
+
+class Trace
+{
+public:
+	// Turning tracing on clears the events of the previous recording
+	static void setEnabled(bool shouldEnable) noexcept;
+	static bool isEnabled() noexcept { return enabled.load(std::memory_order_relaxed) != 0; }
+	static void clear() noexcept;
+
+	// Writes the events still held in the ring, oldest first
+	static bool exportJson(const File& file);
+
+	class Scope
+	{
+	public:
+		// name must outlive the trace, which in practice means a string literal
+		Scope(const char* name) noexcept;
+		// detail is copied and shown as the event's argument
+		Scope(const char* name, const String& detail) noexcept;
+		~Scope() noexcept;
+
+	private:
+		const char* name;
+		String detail;
+		int64 start;
+
+		JUCE_DECLARE_NON_COPYABLE(Scope)
+	};
+
+private:
+	static void record(const char* name, const String& detail, int64 start, int64 end) noexcept;
+
+	static std::atomic<int> enabled;
+};
+
+#define TRACE_SCOPE(name)					const Trace::Scope JUCE_JOIN_MACRO(traceScope, __LINE__) (name)
+#define TRACE_SCOPE_DETAIL(name, detail)	const Trace::Scope JUCE_JOIN_MACRO(traceScope, __LINE__) (name, detail)
+
+#endif /* Trace_h */
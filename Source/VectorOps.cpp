@@ -0,0 +1,207 @@
+//
+//  VectorOps.cpp
+//  Light Host
+//
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "VectorOps.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+
+#if JUCE_INTEL && ! JUCE_NO_INLINE_ASM
+ #define LIGHTHOST_USE_SSE 1
+ #include <emmintrin.h>
+#elif JUCE_ARM && (defined (__ARM_NEON__) || defined (__ARM_NEON))
+ #define LIGHTHOST_USE_NEON 1
+ #include <arm_neon.h>
+#endif
+
+void VectorOps::disableDenormals()
+{
+	#if LIGHTHOST_USE_SSE
+	// FTZ (bit 15) and DAZ (bit 6)
+	_mm_setcsr(_mm_getcsr() | 0x8040);
+	#elif JUCE_ARM && defined (__aarch64__)
+	uint64_t fpcr;
+	asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+	asm volatile("msr fpcr, %0" : : "r"(fpcr | (1 << 24)));
+	#elif JUCE_ARM && defined (__arm__) && ! defined (__SOFTFP__)
+	uint32_t fpscr;
+	asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+	asm volatile("vmsr fpscr, %0" : : "r"(fpscr | (1 << 24)));
+	#endif
+}
+
+int VectorOps::sanitize(float* data, int numSamples, float ceiling)
+{
+	int bad = 0;
+	int i = 0;
+	#if LIGHTHOST_USE_SSE
+	static const int bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+	const __m128 smallest = _mm_set1_ps(FLT_MIN);
+	const __m128 hi = _mm_set1_ps(ceiling);
+	const __m128 lo = _mm_set1_ps(-ceiling);
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(data + i);
+		const __m128 mag = _mm_and_ps(x, absMask);
+		// NaN compares false against everything, so "finite" excludes it as well
+		const __m128 finite = _mm_cmplt_ps(mag, inf);
+		const __m128 normal = _mm_cmpge_ps(mag, smallest);
+		const __m128 over = _mm_cmpgt_ps(mag, hi);
+		bad += bitCount[(~_mm_movemask_ps(finite) | _mm_movemask_ps(over)) & 0xf];
+		x = _mm_and_ps(x, _mm_and_ps(finite, normal));
+		x = _mm_min_ps(_mm_max_ps(x, lo), hi);
+		_mm_storeu_ps(data + i, x);
+	}
+	#elif LIGHTHOST_USE_NEON
+	const float32x4_t inf = vdupq_n_f32(std::numeric_limits<float>::infinity());
+	const float32x4_t smallest = vdupq_n_f32(FLT_MIN);
+	const float32x4_t hi = vdupq_n_f32(ceiling);
+	const float32x4_t lo = vdupq_n_f32(-ceiling);
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		float32x4_t x = vld1q_f32(data + i);
+		const float32x4_t mag = vabsq_f32(x);
+		const uint32x4_t finite = vcltq_f32(mag, inf);
+		const uint32x4_t normal = vcgeq_f32(mag, smallest);
+		const uint32x4_t over = vcgtq_f32(mag, hi);
+		const uint32x4_t offending = vorrq_u32(vmvnq_u32(finite), over);
+		uint32_t lanes[4];
+		vst1q_u32(lanes, vshrq_n_u32(offending, 31));
+		bad += (int) (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+		x = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(x), vandq_u32(finite, normal)));
+		x = vminq_f32(vmaxq_f32(x, lo), hi);
+		vst1q_f32(data + i, x);
+	}
+	#endif
+	for (; i < numSamples; i++)
+	{
+		const float x = data[i];
+		const float mag = std::abs(x);
+		if (! (mag < std::numeric_limits<float>::infinity()))
+		{
+			data[i] = 0.0f;
+			bad++;
+		}
+		else if (mag > ceiling)
+		{
+			data[i] = x > 0.0f ? ceiling : -ceiling;
+			bad++;
+		}
+		else if (mag < FLT_MIN)
+			data[i] = 0.0f;
+	}
+	return bad;
+}
+
+void VectorOps::applyGainRamp(float* data, int numSamples, float startGain, float endGain)
+{
+	if (startGain == endGain)
+	{
+		FloatVectorOperations::multiply(data, startGain, numSamples);
+		return;
+	}
+	const float step = (endGain - startGain) / (float) numSamples;
+	int i = 0;
+	#if LIGHTHOST_USE_SSE
+	__m128 gain = _mm_setr_ps(startGain, startGain + step, startGain + 2.0f * step, startGain + 3.0f * step);
+	const __m128 increment = _mm_set1_ps(4.0f * step);
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), gain));
+		gain = _mm_add_ps(gain, increment);
+	}
+	#elif LIGHTHOST_USE_NEON
+	const float initial[4] = { startGain, startGain + step, startGain + 2.0f * step, startGain + 3.0f * step };
+	float32x4_t gain = vld1q_f32(initial);
+	const float32x4_t increment = vdupq_n_f32(4.0f * step);
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		vst1q_f32(data + i, vmulq_f32(vld1q_f32(data + i), gain));
+		gain = vaddq_f32(gain, increment);
+	}
+	#endif
+	for (; i < numSamples; i++)
+		data[i] *= startGain + step * (float) i;
+}
+
+void VectorOps::swap(float* a, float* b, int numSamples)
+{
+	int i = 0;
+	#if LIGHTHOST_USE_SSE
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(a + i);
+		_mm_storeu_ps(a + i, _mm_loadu_ps(b + i));
+		_mm_storeu_ps(b + i, x);
+	}
+	#elif LIGHTHOST_USE_NEON
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		const float32x4_t x = vld1q_f32(a + i);
+		vst1q_f32(a + i, vld1q_f32(b + i));
+		vst1q_f32(b + i, x);
+	}
+	#endif
+	for (; i < numSamples; i++)
+		std::swap(a[i], b[i]);
+}
+
+float VectorOps::sumOfSquares(const float* data, int numSamples)
+{
+	float sum = 0.0f;
+	int i = 0;
+	#if LIGHTHOST_USE_SSE
+	__m128 acc = _mm_setzero_ps();
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(data + i);
+		acc = _mm_add_ps(acc, _mm_mul_ps(x, x));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	#elif LIGHTHOST_USE_NEON
+	float32x4_t acc = vdupq_n_f32(0.0f);
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		const float32x4_t x = vld1q_f32(data + i);
+		acc = vmlaq_f32(acc, x, x);
+	}
+	float lanes[4];
+	vst1q_f32(lanes, acc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	#endif
+	for (; i < numSamples; i++)
+		sum += data[i] * data[i];
+	return sum;
+}
+
+float VectorOps::dotProduct(const float* a, const float* b, int numSamples)
+{
+	float sum = 0.0f;
+	int i = 0;
+	#if LIGHTHOST_USE_SSE
+	__m128 acc = _mm_setzero_ps();
+	for (; i + 4 <= numSamples; i += 4)
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	float lanes[4];
+	_mm_storeu_ps(lanes, acc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	#elif LIGHTHOST_USE_NEON
+	float32x4_t acc = vdupq_n_f32(0.0f);
+	for (; i + 4 <= numSamples; i += 4)
+		acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+	float lanes[4];
+	vst1q_f32(lanes, acc);
+	sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	#endif
+	for (; i < numSamples; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
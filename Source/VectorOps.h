@@ -0,0 +1,35 @@
+//
+//  VectorOps.h
+//  Light Host
+//
+//  SIMD kernels used on the audio thread. Everything in here is allocation
+//  free and safe to call from the device callback.
+//
+
+#ifndef VectorOps_h
+#define VectorOps_h
+
+namespace VectorOps
+{
+	// Enables flush-to-zero and denormals-are-zero for the calling thread.
+	void disableDenormals();
+
+	// Replaces NaN/Inf samples with silence, flushes denormals and clamps
+	// everything else to +/- ceiling. Returns the number of samples that were
+	// NaN, Inf or above the ceiling.
+	int sanitize(float* data, int numSamples, float ceiling);
+
+	// Multiplies by a gain that moves linearly from startGain to endGain
+	void applyGainRamp(float* data, int numSamples, float startGain, float endGain);
+
+	// Exchanges the contents of two channels in place
+	void swap(float* a, float* b, int numSamples);
+
+	// Sum of x[i]^2, accumulated in four lanes
+	float sumOfSquares(const float* data, int numSamples);
+
+	// Sum of a[i] * b[i], accumulated in four lanes
+	float dotProduct(const float* a, const float* b, int numSamples);
+}
+
+#endif /* VectorOps_h */